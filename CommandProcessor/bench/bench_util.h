@@ -0,0 +1,43 @@
+#ifndef BENCH_UTIL_H
+#define BENCH_UTIL_H
+
+/* -----------------------------------------------------------------------
+ * Shared helpers for the host benchmarks under bench/.
+ * ----------------------------------------------------------------------- */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+static int bench_cmp_u64(const void *a, const void *b)
+{
+    uint64_t x = *(const uint64_t *)a, y = *(const uint64_t *)b;
+    return (x > y) - (x < y);
+}
+
+/* Sort samples[] in place so bench_percentile() can be used on it. */
+static inline void bench_sort(uint64_t *samples, size_t n)
+{
+    qsort(samples, n, sizeof(uint64_t), bench_cmp_u64);
+}
+
+/* p in [0, 1]; samples must be sorted.  Returns 0 for an empty set. */
+static inline uint64_t bench_percentile(const uint64_t *sorted, size_t n, double p)
+{
+    if (n == 0)
+        return 0;
+    return sorted[(size_t)(p * (double)(n - 1))];
+}
+
+/* Small, fast, deterministic PRNG (xorshift32); state must be non-zero. */
+static inline uint32_t bench_rand(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+#endif /* BENCH_UTIL_H */
@@ -0,0 +1,217 @@
+/* -----------------------------------------------------------------------
+ * ingress_bench — push/pop latency under producer contention.
+ *
+ * Runs the same workload against three pools:
+ *
+ *   sorted  the original pool: mutex, condition variable and a sorted
+ *           array of 64 entries (see locked_pool.h).
+ *   bucket  the pool just before the ingress ring: the same mutex and
+ *           condition variable around the O(1) priority buckets, so the
+ *           receive threads and the MCU thread contend on one lock.
+ *   ring    CommandPool — producers publish lock-free and only the
+ *           consumer touches the buckets.
+ *
+ * sorted and bucket are the "before" numbers, ring the "after".
+ *
+ * Each producer pushes a fixed number of commands; the consumer polls
+ * until it has seen them all.  Per-operation latency is taken with
+ * CLOCK_MONOTONIC around each call and reported as percentiles.
+ *
+ * Build on a Linux host:  make bench
+ * Usage:  ingress_bench [producers] [pushes_per_producer]
+ * ----------------------------------------------------------------------- */
+#include "command_pool.h"
+#include "bench_util.h"
+#include "locked_pool.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PRODUCERS 4
+#define DEFAULT_PUSHES 100000
+
+typedef enum
+{
+    MODE_SORTED,
+    MODE_BUCKET,
+    MODE_RING
+} BenchMode;
+
+static const char *mode_name(BenchMode mode)
+{
+    switch (mode)
+    {
+    case MODE_SORTED:
+        return "sorted";
+    case MODE_BUCKET:
+        return "bucket";
+    case MODE_RING:
+    default:
+        return "ring";
+    }
+}
+
+typedef struct
+{
+    BenchMode mode;
+    size_t pushes;
+    uint8_t priority_seed;
+    uint64_t *samples;  /* one latency sample per push */
+    size_t failed;
+} ProducerArgs;
+
+static CommandPool g_pool;
+static SortedPool g_sorted;
+static BucketPool g_bucket;
+static volatile int g_start;
+
+static int bench_push(BenchMode mode, const PoolEntry *e)
+{
+    switch (mode)
+    {
+    case MODE_SORTED:
+        return sorted_pool_push(&g_sorted, e);
+    case MODE_BUCKET:
+        return bucket_pool_push(&g_bucket, e);
+    case MODE_RING:
+    default:
+        return pool_push(&g_pool, e);
+    }
+}
+
+static int bench_pop(BenchMode mode, PoolEntry *out)
+{
+    switch (mode)
+    {
+    case MODE_SORTED:
+        return sorted_pool_try_pop(&g_sorted, out);
+    case MODE_BUCKET:
+        return bucket_pool_try_pop(&g_bucket, out);
+    case MODE_RING:
+    default:
+        return pool_try_pop_best(&g_pool, out);
+    }
+}
+
+static void *producer_thread(void *arg)
+{
+    ProducerArgs *a = (ProducerArgs *)arg;
+    PoolEntry e;
+    memset(&e, 0, sizeof(e));
+    uint32_t rnd = 0x9e3779b9u * (a->priority_seed + 1u);
+
+    while (!g_start)
+        ;
+
+    for (size_t i = 0; i < a->pushes; ++i)
+    {
+        rnd = rnd * 1664525u + 1013904223u;
+        e.priority = (uint8_t)(rnd >> 24);
+
+        uint64_t t0 = monotonic_now_ns();
+        int rc = bench_push(a->mode, &e);
+        a->samples[i] = monotonic_now_ns() - t0;
+
+        if (rc != 0)
+        {
+            a->failed++;
+            --i; /* retry until accepted so every mode pushes the same work */
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void report(const char *mode, const char *op, int producers,
+                   uint64_t *samples, size_t n)
+{
+    bench_sort(samples, n);
+    printf("%-6s %-4s producers=%d n=%zu p50=%llu p99=%llu p99.9=%llu max=%llu (ns)\n",
+           mode, op, producers, n,
+           (unsigned long long)bench_percentile(samples, n, 0.50),
+           (unsigned long long)bench_percentile(samples, n, 0.99),
+           (unsigned long long)bench_percentile(samples, n, 0.999),
+           (unsigned long long)samples[n - 1]);
+}
+
+static void run(BenchMode mode, int producers, size_t pushes)
+{
+    const char *name = mode_name(mode);
+    size_t total = (size_t)producers * pushes;
+
+    pool_init(&g_pool);
+    sorted_pool_init(&g_sorted);
+    bucket_pool_init(&g_bucket);
+    g_start = 0;
+
+    ProducerArgs *args = calloc((size_t)producers, sizeof(*args));
+    pthread_t *threads = calloc((size_t)producers, sizeof(*threads));
+    uint64_t *push_samples = malloc(total * sizeof(uint64_t));
+    uint64_t *pop_samples = malloc(total * sizeof(uint64_t));
+    if (!args || !threads || !push_samples || !pop_samples)
+    {
+        fprintf(stderr, "ingress_bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    for (int p = 0; p < producers; ++p)
+    {
+        args[p].mode = mode;
+        args[p].pushes = pushes;
+        args[p].priority_seed = (uint8_t)p;
+        args[p].samples = push_samples + (size_t)p * pushes;
+        pthread_create(&threads[p], NULL, producer_thread, &args[p]);
+    }
+
+    g_start = 1;
+
+    size_t popped = 0;
+    PoolEntry out;
+    while (popped < total)
+    {
+        uint64_t t0 = monotonic_now_ns();
+        int rc = bench_pop(mode, &out);
+        uint64_t dt = monotonic_now_ns() - t0;
+        if (rc == 0)
+            pop_samples[popped++] = dt;
+    }
+
+    size_t failed = 0;
+    for (int p = 0; p < producers; ++p)
+    {
+        pthread_join(threads[p], NULL);
+        failed += args[p].failed;
+    }
+
+    report(name, "push", producers, push_samples, total);
+    report(name, "pop", producers, pop_samples, total);
+    printf("%-6s pool-full retries=%zu\n", name, failed);
+
+    free(args);
+    free(threads);
+    free(push_samples);
+    free(pop_samples);
+    pool_destroy(&g_pool);
+    sorted_pool_destroy(&g_sorted);
+    bucket_pool_destroy(&g_bucket);
+}
+
+int main(int argc, char **argv)
+{
+    int producers = (argc > 1) ? atoi(argv[1]) : DEFAULT_PRODUCERS;
+    size_t pushes = (argc > 2) ? (size_t)strtoul(argv[2], NULL, 10) : DEFAULT_PUSHES;
+
+    if (producers < 1 || pushes == 0)
+    {
+        fprintf(stderr, "usage: %s [producers] [pushes_per_producer]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    run(MODE_SORTED, producers, pushes);
+    run(MODE_BUCKET, producers, pushes);
+    run(MODE_RING, producers, pushes);
+    return EXIT_SUCCESS;
+}
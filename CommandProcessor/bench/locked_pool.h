@@ -0,0 +1,246 @@
+#ifndef LOCKED_POOL_H
+#define LOCKED_POOL_H
+
+/* -----------------------------------------------------------------------
+ * Reference copies of the command pool as it was before the lock-free
+ * ingress ring, for ingress_bench's before/after comparison.  Host
+ * benchmarks only.
+ *
+ *   SortedPool  the original pool: one pthread mutex and condition
+ *               variable around an array of SORTED_POOL_CAPACITY entries
+ *               kept sorted by priority, O(n) insert and pop.
+ *   BucketPool  the pool just before the ring: the same mutex and
+ *               condition variable around one FIFO bucket per priority
+ *               plus a bitmap, O(1) push and pop, lazy expiry.
+ *
+ * Both keep the original locking exactly — every push and pop takes the
+ * one mutex, and every push signals the condition variable.  Only the
+ * "pool full" message on stderr is left out, so retries do not time
+ * stdio.  The blocking pops are replaced by a try-pop under the same
+ * lock, because the benchmark consumer polls in every mode.
+ * ----------------------------------------------------------------------- */
+
+#include "command_pool.h"
+
+#include <pthread.h>
+#include <string.h>
+
+/* -----------------------------------------------------------------------
+ * SortedPool
+ * ----------------------------------------------------------------------- */
+
+#define SORTED_POOL_CAPACITY 64u
+
+typedef struct
+{
+    PoolEntry entries[SORTED_POOL_CAPACITY];
+    size_t count;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+} SortedPool;
+
+static inline void sorted_pool_init(SortedPool *pool)
+{
+    memset(pool->entries, 0, sizeof(pool->entries));
+    pool->count = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->not_empty, &cattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+static inline void sorted_pool_destroy(SortedPool *pool)
+{
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/* Insertion that keeps the array sorted best to worst.  Returns 0, or -1
+ * if the pool is full. */
+static inline int sorted_pool_push(SortedPool *pool, const PoolEntry *entry)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->count >= SORTED_POOL_CAPACITY)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+
+    size_t insert_at = pool->count;
+    for (size_t i = 0; i < pool->count; ++i)
+    {
+        if (entry->priority > pool->entries[i].priority)
+        {
+            insert_at = i;
+            break;
+        }
+    }
+    for (size_t i = pool->count; i > insert_at; --i)
+        pool->entries[i] = pool->entries[i - 1];
+
+    pool->entries[insert_at] = *entry;
+    pool->count++;
+
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/* Returns 0 and fills *out, or 1 if the pool is empty. */
+static inline int sorted_pool_try_pop(SortedPool *pool, PoolEntry *out)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->count == 0)
+    {
+        pthread_mutex_unlock(&pool->lock);
+        return 1;
+    }
+
+    *out = pool->entries[0];
+    for (size_t i = 0; i < pool->count - 1; ++i)
+        pool->entries[i] = pool->entries[i + 1];
+    pool->count--;
+
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/* -----------------------------------------------------------------------
+ * BucketPool
+ * ----------------------------------------------------------------------- */
+
+typedef struct
+{
+    PoolEntry entry;
+    uint16_t next;
+} BucketPoolSlot;
+
+typedef struct
+{
+    BucketPoolSlot slots[POOL_CAPACITY];
+    PoolBucket buckets[POOL_PRIORITY_LEVELS];
+    uint64_t bitmap[POOL_BITMAP_WORDS];
+    uint16_t free_head;
+    size_t count;
+    uint64_t pushed, popped, dropped_full, expired;
+    pthread_mutex_t lock;
+    pthread_cond_t not_empty;
+} BucketPool;
+
+static inline void bucket_pool_init(BucketPool *pool)
+{
+    memset(pool, 0, sizeof(*pool));
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+    {
+        pool->buckets[p].head = POOL_INDEX_NONE;
+        pool->buckets[p].tail = POOL_INDEX_NONE;
+    }
+    for (size_t i = 0; i < POOL_CAPACITY; ++i)
+        pool->slots[i].next = (i + 1 < POOL_CAPACITY) ? (uint16_t)(i + 1) : POOL_INDEX_NONE;
+    pool->free_head = 0;
+    pthread_mutex_init(&pool->lock, NULL);
+
+    pthread_condattr_t cattr;
+    pthread_condattr_init(&cattr);
+    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    pthread_cond_init(&pool->not_empty, &cattr);
+    pthread_condattr_destroy(&cattr);
+}
+
+static inline void bucket_pool_destroy(BucketPool *pool)
+{
+    pthread_cond_destroy(&pool->not_empty);
+    pthread_mutex_destroy(&pool->lock);
+}
+
+/* O(1): take a slot off the free list and append it to the FIFO bucket
+ * for its priority.  Returns 0, or -1 if the pool is full. */
+static inline int bucket_pool_push(BucketPool *pool, const PoolEntry *entry)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    if (pool->free_head == POOL_INDEX_NONE)
+    {
+        pool->dropped_full++;
+        pthread_mutex_unlock(&pool->lock);
+        return -1;
+    }
+
+    uint16_t idx = pool->free_head;
+    pool->free_head = pool->slots[idx].next;
+    pool->slots[idx].entry = *entry;
+
+    uint8_t prio = entry->priority;
+    PoolBucket *b = &pool->buckets[prio];
+    pool->slots[idx].next = POOL_INDEX_NONE;
+    if (b->tail == POOL_INDEX_NONE)
+    {
+        b->head = idx;
+        pool->bitmap[prio >> 6] |= (uint64_t)1 << (prio & 63u);
+    }
+    else
+    {
+        pool->slots[b->tail].next = idx;
+    }
+    b->tail = idx;
+    pool->count++;
+    pool->pushed++;
+
+    pthread_cond_signal(&pool->not_empty);
+    pthread_mutex_unlock(&pool->lock);
+    return 0;
+}
+
+/* O(1) plus any stale bucket heads discarded on the way.  Returns 0 and
+ * fills *out, or 1 if no live entry is queued. */
+static inline int bucket_pool_try_pop(BucketPool *pool, PoolEntry *out)
+{
+    pthread_mutex_lock(&pool->lock);
+
+    const uint64_t now_ns = monotonic_now_ns();
+    int rc = 1;
+    while (pool->count > 0)
+    {
+        int prio = -1;
+        for (int w = (int)POOL_BITMAP_WORDS - 1; w >= 0 && prio < 0; --w)
+            if (pool->bitmap[w] != 0)
+                prio = w * 64 + (63 - __builtin_clzll(pool->bitmap[w]));
+
+        PoolBucket *b = &pool->buckets[prio];
+        uint16_t idx = b->head;
+        b->head = pool->slots[idx].next;
+        if (b->head == POOL_INDEX_NONE)
+        {
+            b->tail = POOL_INDEX_NONE;
+            pool->bitmap[prio >> 6] &= ~((uint64_t)1 << (prio & 63));
+        }
+
+        const PoolEntry *e = &pool->slots[idx].entry;
+        int stale = e->valid_until_ns != POOL_NO_DEADLINE && e->valid_until_ns <= now_ns;
+        if (!stale)
+            *out = *e;
+
+        pool->slots[idx].next = pool->free_head;
+        pool->free_head = idx;
+        pool->count--;
+
+        if (stale)
+        {
+            pool->expired++;
+            continue;
+        }
+        pool->popped++;
+        rc = 0;
+        break;
+    }
+
+    pthread_mutex_unlock(&pool->lock);
+    return rc;
+}
+
+#endif /* LOCKED_POOL_H */
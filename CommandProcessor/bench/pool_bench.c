@@ -0,0 +1,645 @@
+/* -----------------------------------------------------------------------
+ * pool_bench — CommandPool microbenchmark and contention suite.
+ *
+ * Runs three groups of measurements and prints one JSON object per line
+ * on stdout, so results can be diffed or loaded into a notebook:
+ *
+ *   single_thread  push/pop throughput with no contention, for a few
+ *                  fill levels (push N, then pop N), per scheduling
+ *                  policy.
+ *   contention     1..8 producer threads against one consumer blocked in
+ *                  pool_pop_batch, as in the real process.  Reports
+ *                  throughput, push latency and queueing (sojourn) time
+ *                  from push to pop.
+ *   priority_mix   sojourn-time percentiles per priority mix (uniform,
+ *                  skewed, all-equal), split into the top priority band
+ *                  and everything else, with 4 producers.
+ *   policy         one overloaded traffic pattern per scheduling policy:
+ *                  an urgent high-priority stream, a low-priority bulk
+ *                  stream and a deadline-free sender, arriving faster
+ *                  than the consumer serves them.  Reports per flow the
+ *                  share of service, sojourn percentiles, losses and the
+ *                  longest gap between two services (starvation).
+ *   flood          low-priority producers flooding a fixed-rate consumer
+ *                  that takes one command per tick, with a trickle of
+ *                  top-priority commands, per overload policy.  Reports
+ *                  where each band was lost: at the ingress ring, in
+ *                  the pool, or not at all.
+ *
+ * Human-readable progress goes to stderr.
+ *
+ * Build on a Linux host:  make bench
+ * Usage:  pool_bench [pushes_per_producer]
+ * ----------------------------------------------------------------------- */
+#include "command_pool.h"
+#include "bench_util.h"
+
+#include <pthread.h>
+#include <sched.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEFAULT_PUSHES 50000
+#define MAX_PRODUCERS 8
+#define CONSUMER_BATCH 16
+
+/* Priorities at or above this are reported as the "high" band. */
+#define HIGH_BAND_MIN 128u
+
+typedef enum
+{
+    MIX_UNIFORM, /* every priority equally likely             */
+    MIX_SKEWED,  /* mostly low priority, rare urgent commands */
+    MIX_EQUAL    /* a single priority: FIFO behaviour         */
+} PriorityMix;
+
+static const char *mix_name(PriorityMix mix)
+{
+    switch (mix)
+    {
+    case MIX_UNIFORM:
+        return "uniform";
+    case MIX_SKEWED:
+        return "skewed";
+    case MIX_EQUAL:
+    default:
+        return "equal";
+    }
+}
+
+static uint8_t next_priority(PriorityMix mix, uint32_t *rnd)
+{
+    uint32_t r = bench_rand(rnd);
+
+    switch (mix)
+    {
+    case MIX_UNIFORM:
+        return (uint8_t)(r >> 24);
+    case MIX_SKEWED:
+        /* 90% in 0..15, 9% in 16..127, 1% in 128..255. */
+        if ((r % 100u) < 90u)
+            return (uint8_t)((r >> 8) & 0x0Fu);
+        if ((r % 100u) < 99u)
+            return (uint8_t)(16u + ((r >> 8) % 112u));
+        return (uint8_t)(HIGH_BAND_MIN + ((r >> 8) & 0x7Fu));
+    case MIX_EQUAL:
+    default:
+        return 128u;
+    }
+}
+
+static CommandPool g_pool;
+
+/* -----------------------------------------------------------------------
+ * Single-thread throughput
+ * ----------------------------------------------------------------------- */
+
+static void bench_single_thread(size_t fill, PoolSchedPolicy policy)
+{
+    const size_t rounds = 200;
+    PoolEntry e, out;
+    memset(&e, 0, sizeof(e));
+    e.source = POOL_SOURCE_NONE;
+    uint32_t rnd = 12345u;
+
+    /* The ring must absorb a whole fill between drains. */
+    if (fill > POOL_INGRESS_CAPACITY)
+        fill = POOL_INGRESS_CAPACITY;
+
+    pool_init(&g_pool);
+    pool_set_sched_policy(&g_pool, policy);
+
+    uint64_t push_ns = 0, pop_ns = 0;
+    for (size_t r = 0; r < rounds; ++r)
+    {
+        uint64_t t0 = monotonic_now_ns();
+        e.recv_ns = t0;
+        for (size_t i = 0; i < fill; ++i)
+        {
+            e.priority = next_priority(MIX_UNIFORM, &rnd);
+            pool_push(&g_pool, &e);
+        }
+        uint64_t t1 = monotonic_now_ns();
+        for (size_t i = 0; i < fill; ++i)
+            pool_try_pop_best(&g_pool, &out);
+        uint64_t t2 = monotonic_now_ns();
+
+        push_ns += t1 - t0;
+        pop_ns += t2 - t1; /* includes draining the ring into buckets */
+    }
+
+    double ops = (double)(rounds * fill);
+    printf("{\"bench\":\"single_thread\",\"policy\":\"%s\",\"fill\":%zu,\"ops\":%.0f,"
+           "\"push_ns_per_op\":%.1f,\"pop_ns_per_op\":%.1f,"
+           "\"push_mops\":%.2f,\"pop_mops\":%.2f}\n",
+           pool_sched_policy_name(policy), fill, ops,
+           (double)push_ns / ops, (double)pop_ns / ops,
+           ops / ((double)push_ns / 1e3), ops / ((double)pop_ns / 1e3));
+
+    pool_destroy(&g_pool);
+}
+
+/* -----------------------------------------------------------------------
+ * Producer / consumer runs
+ * ----------------------------------------------------------------------- */
+
+typedef struct
+{
+    PriorityMix mix;
+    size_t pushes;
+    uint32_t seed;
+    uint64_t *push_samples;
+    size_t retries;
+} ProducerArgs;
+
+typedef struct
+{
+    uint64_t *sojourn_high;
+    size_t n_high;
+    uint64_t *sojourn_low;
+    size_t n_low;
+} ConsumerResult;
+
+static volatile int g_start;
+static volatile int g_producers_done;
+
+static void *producer_thread(void *arg)
+{
+    ProducerArgs *a = (ProducerArgs *)arg;
+    PoolEntry e;
+    memset(&e, 0, sizeof(e));
+    e.source = POOL_SOURCE_NONE;
+    uint32_t rnd = a->seed;
+
+    while (!g_start)
+        sched_yield();
+
+    for (size_t i = 0; i < a->pushes;)
+    {
+        e.priority = next_priority(a->mix, &rnd);
+
+        uint64_t t0 = monotonic_now_ns();
+        e.recv_ns = t0;
+        int rc = pool_push(&g_pool, &e);
+        a->push_samples[i] = monotonic_now_ns() - t0;
+
+        if (rc == 0)
+        {
+            ++i;
+        }
+        else
+        {
+            /* Ring full: let the consumer catch up and retry. */
+            a->retries++;
+            sched_yield();
+        }
+    }
+    return NULL;
+}
+
+static void run_producers(int producers, size_t pushes, PriorityMix mix,
+                          const char *bench)
+{
+    size_t total = (size_t)producers * pushes;
+    ProducerArgs args[MAX_PRODUCERS];
+    pthread_t threads[MAX_PRODUCERS];
+    uint64_t *push_samples = malloc(total * sizeof(uint64_t));
+    ConsumerResult res;
+    res.sojourn_high = malloc(total * sizeof(uint64_t));
+    res.sojourn_low = malloc(total * sizeof(uint64_t));
+    res.n_high = res.n_low = 0;
+
+    if (!push_samples || !res.sojourn_high || !res.sojourn_low)
+    {
+        fprintf(stderr, "pool_bench: out of memory\n");
+        exit(EXIT_FAILURE);
+    }
+
+    pool_init(&g_pool);
+    g_start = 0;
+    g_producers_done = 0;
+
+    for (int p = 0; p < producers; ++p)
+    {
+        args[p].mix = mix;
+        args[p].pushes = pushes;
+        args[p].seed = 0x9e3779b9u * (uint32_t)(p + 1);
+        args[p].push_samples = push_samples + (size_t)p * pushes;
+        args[p].retries = 0;
+        pthread_create(&threads[p], NULL, producer_thread, &args[p]);
+    }
+
+    uint64_t t_start = monotonic_now_ns();
+    g_start = 1;
+
+    /* Consume on this thread exactly as mcu_thread does. */
+    size_t popped = 0;
+    PoolEntry batch[CONSUMER_BATCH];
+    while (popped < total)
+    {
+        struct timespec deadline;
+        clock_gettime(CLOCK_MONOTONIC, &deadline);
+        deadline.tv_sec += 1;
+
+        int n = pool_pop_batch(&g_pool, batch, CONSUMER_BATCH, &deadline);
+        if (n <= 0)
+            break; /* producers stalled for a full second — give up */
+
+        uint64_t now = monotonic_now_ns();
+        for (int i = 0; i < n; ++i)
+        {
+            uint64_t sojourn = now - batch[i].recv_ns;
+            if (batch[i].priority >= HIGH_BAND_MIN)
+                res.sojourn_high[res.n_high++] = sojourn;
+            else
+                res.sojourn_low[res.n_low++] = sojourn;
+        }
+        popped += (size_t)n;
+    }
+    uint64_t elapsed = monotonic_now_ns() - t_start;
+
+    size_t retries = 0;
+    for (int p = 0; p < producers; ++p)
+    {
+        pthread_join(threads[p], NULL);
+        retries += args[p].retries;
+    }
+
+    PoolStats stats;
+    pool_get_stats(&g_pool, &stats);
+
+    bench_sort(push_samples, total);
+    bench_sort(res.sojourn_high, res.n_high);
+    bench_sort(res.sojourn_low, res.n_low);
+
+    printf("{\"bench\":\"%s\",\"mix\":\"%s\",\"producers\":%d,\"pushed\":%zu,"
+           "\"popped\":%zu,\"elapsed_ns\":%llu,\"throughput_mops\":%.3f,"
+           "\"ingress_full\":%llu,\"retries\":%zu,"
+           "\"push_p50_ns\":%llu,\"push_p99_ns\":%llu,\"push_p999_ns\":%llu,\"push_max_ns\":%llu,"
+           "\"high_n\":%zu,\"high_sojourn_p50_ns\":%llu,\"high_sojourn_p99_ns\":%llu,"
+           "\"high_sojourn_p999_ns\":%llu,"
+           "\"low_n\":%zu,\"low_sojourn_p50_ns\":%llu,\"low_sojourn_p99_ns\":%llu,"
+           "\"low_sojourn_p999_ns\":%llu}\n",
+           bench, mix_name(mix), producers, total, popped,
+           (unsigned long long)elapsed,
+           (double)popped / ((double)elapsed / 1e3),
+           (unsigned long long)stats.ingress_full, retries,
+           (unsigned long long)bench_percentile(push_samples, total, 0.50),
+           (unsigned long long)bench_percentile(push_samples, total, 0.99),
+           (unsigned long long)bench_percentile(push_samples, total, 0.999),
+           (unsigned long long)bench_percentile(push_samples, total, 1.0),
+           res.n_high,
+           (unsigned long long)bench_percentile(res.sojourn_high, res.n_high, 0.50),
+           (unsigned long long)bench_percentile(res.sojourn_high, res.n_high, 0.99),
+           (unsigned long long)bench_percentile(res.sojourn_high, res.n_high, 0.999),
+           res.n_low,
+           (unsigned long long)bench_percentile(res.sojourn_low, res.n_low, 0.50),
+           (unsigned long long)bench_percentile(res.sojourn_low, res.n_low, 0.99),
+           (unsigned long long)bench_percentile(res.sojourn_low, res.n_low, 0.999));
+    fflush(stdout);
+
+    pool_destroy(&g_pool);
+    free(push_samples);
+    free(res.sojourn_high);
+    free(res.sojourn_low);
+}
+
+/* -----------------------------------------------------------------------
+ * Scheduling policies under overload
+ *
+ * Runs on one thread against the real clock, so deadlines and aging
+ * behave as in the process: every POLICY_ROUND_NS the flows push their
+ * arrivals and the consumer then pops POLICY_SERVICE entries.  The urgent
+ * stream alone keeps the consumer busy and the other two trickle in on
+ * top, so strict priority never serves them and the policy alone decides
+ * who waits.  A full pool evicts its oldest entry, which favours no
+ * policy.  Each flow has its own priority, which identifies it on pop
+ * and in the per-priority counters.
+ * ----------------------------------------------------------------------- */
+
+#define POLICY_ROUNDS 20000u
+#define POLICY_ROUND_NS 20000ull
+#define POLICY_SERVICE 3u
+#define POLICY_AGING_STEP_NS 100000ull
+
+typedef struct
+{
+    const char *name;
+    uint8_t source;
+    uint8_t priority;
+    uint8_t weight;       /* WFQ share                            */
+    uint32_t freshness_us; /* 0 = never expires                   */
+    unsigned every;       /* push `per_round` entries every N rounds */
+    unsigned per_round;
+} PolicyFlow;
+
+static const PolicyFlow g_policy_flows[] = {
+    /* name      source            prio  weight  fresh_us  every  per_round */
+    {"urgent", 0u, 200u, 2u, 20000u, 1u, 3u},
+    {"bulk", 1u, 20u, 1u, 50000u, 4u, 1u},
+    {"nodeadline", POOL_SOURCE_NONE, 100u, 1u, 0u, 8u, 1u},
+};
+#define POLICY_FLOWS (sizeof(g_policy_flows) / sizeof(g_policy_flows[0]))
+
+static void bench_policy(PoolSchedPolicy policy)
+{
+    const size_t max_served = (size_t)POLICY_ROUNDS * POLICY_SERVICE;
+    uint64_t *sojourn[POLICY_FLOWS];
+    size_t served[POLICY_FLOWS], offered[POLICY_FLOWS];
+    uint64_t last_ns[POLICY_FLOWS], max_gap_ns[POLICY_FLOWS];
+    int8_t flow_of[POOL_PRIORITY_LEVELS];
+
+    memset(flow_of, -1, sizeof(flow_of));
+    for (size_t f = 0; f < POLICY_FLOWS; ++f)
+    {
+        sojourn[f] = malloc(max_served * sizeof(uint64_t));
+        if (!sojourn[f])
+        {
+            fprintf(stderr, "pool_bench: out of memory\n");
+            exit(EXIT_FAILURE);
+        }
+        served[f] = offered[f] = 0;
+        max_gap_ns[f] = 0;
+        flow_of[g_policy_flows[f].priority] = (int8_t)f;
+    }
+
+    pool_init(&g_pool);
+    pool_set_sched_policy(&g_pool, policy);
+    pool_set_overload_policy(&g_pool, POOL_OVERLOAD_EVICT_OLDEST);
+    pool_set_aging_step(&g_pool, POLICY_AGING_STEP_NS);
+    for (size_t f = 0; f < POLICY_FLOWS; ++f)
+        pool_set_source_weight(&g_pool, g_policy_flows[f].source, g_policy_flows[f].weight);
+
+    PoolEntry e;
+    memset(&e, 0, sizeof(e));
+    const uint64_t t_start = monotonic_now_ns();
+    for (size_t f = 0; f < POLICY_FLOWS; ++f)
+        last_ns[f] = t_start;
+
+    for (unsigned r = 0; r < POLICY_ROUNDS; ++r)
+    {
+        uint64_t due = t_start + (uint64_t)r * POLICY_ROUND_NS;
+        while (monotonic_now_ns() < due)
+        {
+        }
+
+        for (size_t f = 0; f < POLICY_FLOWS; ++f)
+        {
+            const PolicyFlow *fl = &g_policy_flows[f];
+            if (r % fl->every != 0)
+                continue;
+            for (unsigned i = 0; i < fl->per_round; ++i)
+            {
+                e.source = fl->source;
+                e.priority = fl->priority;
+                e.recv_ns = monotonic_now_ns();
+                e.valid_until_ns = fl->freshness_us
+                                       ? e.recv_ns + (uint64_t)fl->freshness_us * 1000u
+                                       : POOL_NO_DEADLINE;
+                if (pool_push(&g_pool, &e) == 0)
+                    offered[f]++;
+            }
+        }
+
+        PoolEntry out;
+        for (unsigned i = 0; i < POLICY_SERVICE && pool_try_pop_best(&g_pool, &out) == 0; ++i)
+        {
+            uint64_t now = monotonic_now_ns();
+            int f = flow_of[out.priority];
+            if (f < 0)
+                continue;
+            sojourn[f][served[f]++] = now - out.recv_ns;
+            if (now - last_ns[f] > max_gap_ns[f])
+                max_gap_ns[f] = now - last_ns[f];
+            last_ns[f] = now;
+        }
+    }
+    const uint64_t t_end = monotonic_now_ns();
+
+    PoolStats stats;
+    pool_get_stats(&g_pool, &stats);
+
+    size_t total_served = 0;
+    for (size_t f = 0; f < POLICY_FLOWS; ++f)
+        total_served += served[f];
+
+    for (size_t f = 0; f < POLICY_FLOWS; ++f)
+    {
+        const PolicyFlow *fl = &g_policy_flows[f];
+        /* A flow still waiting at the end has been starved since its last
+         * service. */
+        if (t_end - last_ns[f] > max_gap_ns[f])
+            max_gap_ns[f] = t_end - last_ns[f];
+        bench_sort(sojourn[f], served[f]);
+
+        printf("{\"bench\":\"policy\",\"policy\":\"%s\",\"flow\":\"%s\",\"priority\":%u,"
+               "\"weight\":%u,\"offered\":%zu,\"served\":%zu,\"share\":%.3f,"
+               "\"expired\":%llu,\"dropped\":%llu,"
+               "\"sojourn_p50_ns\":%llu,\"sojourn_p99_ns\":%llu,\"sojourn_max_ns\":%llu,"
+               "\"max_gap_ns\":%llu,\"elapsed_ns\":%llu}\n",
+               pool_sched_policy_name(policy), fl->name, (unsigned)fl->priority,
+               (unsigned)fl->weight, offered[f], served[f],
+               total_served ? (double)served[f] / (double)total_served : 0.0,
+               (unsigned long long)stats.expired_by_priority[fl->priority],
+               (unsigned long long)stats.dropped_by_priority[fl->priority],
+               (unsigned long long)bench_percentile(sojourn[f], served[f], 0.50),
+               (unsigned long long)bench_percentile(sojourn[f], served[f], 0.99),
+               (unsigned long long)bench_percentile(sojourn[f], served[f], 1.0),
+               (unsigned long long)max_gap_ns[f],
+               (unsigned long long)(t_end - t_start));
+        free(sojourn[f]);
+    }
+    fflush(stdout);
+
+    pool_destroy(&g_pool);
+}
+
+/* -----------------------------------------------------------------------
+ * Low-priority flood against a slow consumer
+ *
+ * FLOOD_PRODUCERS threads push batches of priority 0..127 as fast as they
+ * can and never retry, like receive threads under a datagram flood; one
+ * more pushes a priority-255 command every FLOOD_HIGH_PERIOD_NS, well
+ * within what the consumer serves, so any loss of those is due to the
+ * flood.  The
+ * consumer runs as the fixed-rate MCU loop does: sleep to the next tick,
+ * take one command.  So the ring fills many times over between two
+ * drains, and the pool fills within a few ticks.  At the end the pool is
+ * drained; a top-priority command that was neither served then nor
+ * before was lost.
+ * ----------------------------------------------------------------------- */
+
+#define FLOOD_PRODUCERS 2
+#define FLOOD_BATCH 16u
+#define FLOOD_TICKS 1000u
+#define FLOOD_TICK_NS 1000000ull
+#define FLOOD_HIGH_PERIOD_NS 4000000ull
+#define FLOOD_HIGH_PRIORITY 255u
+
+typedef struct
+{
+    int high;        /* 1 = the top-priority trickle            */
+    uint32_t seed;
+    size_t offered;
+    size_t accepted; /* through the ingress ring                 */
+} FloodArgs;
+
+static volatile int g_flood_stop;
+
+static void *flood_thread(void *arg)
+{
+    FloodArgs *a = (FloodArgs *)arg;
+    PoolEntry batch[FLOOD_BATCH];
+    memset(batch, 0, sizeof(batch));
+    uint32_t rnd = a->seed;
+
+    while (!g_start)
+        sched_yield();
+
+    struct timespec next;
+    clock_gettime(CLOCK_MONOTONIC, &next);
+    while (!g_flood_stop)
+    {
+        size_t n = a->high ? 1u : FLOOD_BATCH;
+        uint64_t now = monotonic_now_ns();
+        for (size_t i = 0; i < n; ++i)
+        {
+            batch[i].source = POOL_SOURCE_NONE;
+            batch[i].priority = a->high ? FLOOD_HIGH_PRIORITY
+                                        : (uint8_t)(bench_rand(&rnd) & 0x7Fu);
+            batch[i].recv_ns = now;
+            batch[i].valid_until_ns = POOL_NO_DEADLINE;
+        }
+        a->offered += n;
+        a->accepted += pool_push_batch(&g_pool, batch, n);
+
+        if (a->high)
+        {
+            uint64_t due = timespec_to_ns(&next) + FLOOD_HIGH_PERIOD_NS;
+            next.tv_sec = (time_t)(due / 1000000000ull);
+            next.tv_nsec = (long)(due % 1000000000ull);
+            clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+        }
+    }
+    return NULL;
+}
+
+static void bench_flood(PoolOverloadPolicy overload, const char *overload_name)
+{
+    FloodArgs args[FLOOD_PRODUCERS + 1];
+    pthread_t threads[FLOOD_PRODUCERS + 1];
+
+    pool_init(&g_pool);
+    pool_set_overload_policy(&g_pool, overload);
+    g_start = 0;
+    g_flood_stop = 0;
+
+    for (int p = 0; p <= FLOOD_PRODUCERS; ++p)
+    {
+        args[p].high = (p == FLOOD_PRODUCERS);
+        args[p].seed = 0x9e3779b9u * (uint32_t)(p + 1);
+        args[p].offered = args[p].accepted = 0;
+        pthread_create(&threads[p], NULL, flood_thread, &args[p]);
+    }
+    g_start = 1;
+
+    size_t served_high = 0, served_low = 0;
+    PoolEntry out;
+    uint64_t next_ns = monotonic_now_ns();
+    for (unsigned t = 0; t < FLOOD_TICKS; ++t)
+    {
+        struct timespec deadline;
+        next_ns += FLOOD_TICK_NS;
+        deadline.tv_sec = (time_t)(next_ns / 1000000000ull);
+        deadline.tv_nsec = (long)(next_ns % 1000000000ull);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+
+        if (pool_try_pop_best(&g_pool, &out) == 0)
+        {
+            if (out.priority == FLOOD_HIGH_PRIORITY)
+                served_high++;
+            else
+                served_low++;
+        }
+    }
+
+    g_flood_stop = 1;
+    for (int p = 0; p <= FLOOD_PRODUCERS; ++p)
+        pthread_join(threads[p], NULL);
+
+    /* Whatever is still queued was not lost. */
+    size_t queued_high = 0, queued_low = 0;
+    while (pool_try_pop_best(&g_pool, &out) == 0)
+    {
+        if (out.priority == FLOOD_HIGH_PRIORITY)
+            queued_high++;
+        else
+            queued_low++;
+    }
+
+    PoolStats stats;
+    pool_get_stats(&g_pool, &stats);
+
+    size_t low_offered = 0, low_accepted = 0;
+    for (int p = 0; p < FLOOD_PRODUCERS; ++p)
+    {
+        low_offered += args[p].offered;
+        low_accepted += args[p].accepted;
+    }
+    const FloodArgs *high = &args[FLOOD_PRODUCERS];
+
+    printf("{\"bench\":\"flood\",\"overload\":\"%s\",\"ticks\":%u,"
+           "\"high_offered\":%zu,\"high_ring_rejected\":%zu,\"high_pool_dropped\":%llu,"
+           "\"high_served\":%zu,\"high_queued\":%zu,\"high_lost\":%zu,"
+           "\"low_offered\":%zu,\"low_ring_rejected\":%zu,\"low_served\":%zu,"
+           "\"low_queued\":%zu}\n",
+           overload_name, FLOOD_TICKS,
+           high->offered, high->offered - high->accepted,
+           (unsigned long long)stats.dropped_by_priority[FLOOD_HIGH_PRIORITY],
+           served_high, queued_high, high->offered - served_high - queued_high,
+           low_offered, low_offered - low_accepted, served_low, queued_low);
+    fflush(stdout);
+
+    pool_destroy(&g_pool);
+}
+
+/* -----------------------------------------------------------------------
+ * main
+ * ----------------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    size_t pushes = (argc > 1) ? (size_t)strtoul(argv[1], NULL, 10) : DEFAULT_PUSHES;
+    if (pushes == 0)
+    {
+        fprintf(stderr, "usage: %s [pushes_per_producer]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    static const size_t fills[] = {1, 16, 64, 256};
+    fprintf(stderr, "pool_bench: single-thread throughput\n");
+    for (unsigned p = 0; p < POOL_SCHED_POLICY_COUNT; ++p)
+        for (size_t i = 0; i < sizeof(fills) / sizeof(fills[0]); ++i)
+            bench_single_thread(fills[i], (PoolSchedPolicy)p);
+
+    fprintf(stderr, "pool_bench: producer/consumer contention\n");
+    for (int producers = 1; producers <= MAX_PRODUCERS; producers *= 2)
+        run_producers(producers, pushes, MIX_UNIFORM, "contention");
+
+    fprintf(stderr, "pool_bench: priority mixes\n");
+    run_producers(4, pushes, MIX_UNIFORM, "priority_mix");
+    run_producers(4, pushes, MIX_SKEWED, "priority_mix");
+    run_producers(4, pushes, MIX_EQUAL, "priority_mix");
+
+    fprintf(stderr, "pool_bench: scheduling policies under overload\n");
+    for (unsigned p = 0; p < POOL_SCHED_POLICY_COUNT; ++p)
+        bench_policy((PoolSchedPolicy)p);
+
+    fprintf(stderr, "pool_bench: low-priority flood against a slow consumer\n");
+    bench_flood(POOL_OVERLOAD_EVICT_LOWEST, "evict_lowest");
+    bench_flood(POOL_OVERLOAD_EVICT_OLDEST, "evict_oldest");
+    bench_flood(POOL_OVERLOAD_REJECT, "reject");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,267 @@
+/* -----------------------------------------------------------------------
+ * rt_jitter — end-to-end jitter test of the receive→forward path.
+ *
+ * Runs the real interface, pool and MCU threads in-process on loopback:
+ * a sender thread emits one v1 command every 1/rate seconds on an
+ * absolute schedule, each carrying its CLOCK_MONOTONIC send time in the
+ * payload; the MCU thread forwards it to a sink socket whose kernel
+ * receive stamp ends the measurement.  Meanwhile background threads
+ * thrash the caches and make syscalls, so the run shows what the path
+ * does under interference — compare a plain run with one using --rt.
+ *
+ * Prints a latency histogram and a summary on stderr and one JSON object
+ * on stdout.  Worst case ("max_us") is the figure to watch.
+ *
+ * Build on a Linux host:  make bench
+ * Usage:  rt_jitter [--rt] [-n packets] [-f rate_hz] [-l load_threads]
+ *                   [-c interface_cpu,mcu_cpu]
+ * --rt needs CAP_SYS_NICE / CAP_IPC_LOCK (or root) to take full effect.
+ * ----------------------------------------------------------------------- */
+#include "command_interface.h"
+#include "mcu_logic.h"
+#include "rt_thread.h"
+#include "rx_timestamp.h"
+#include "bench_util.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+#define SOURCE_PORT 15100u
+#define SINK_PORT 15101u
+#define MAX_LOAD_THREADS 16
+
+/* Bytes each load thread sweeps per pass — larger than a typical L2. */
+#define LOAD_BUFFER_SIZE (4u * 1024u * 1024u)
+
+static volatile int g_load_running = 1;
+
+static void *load_thread(void *arg)
+{
+    (void)arg;
+    uint8_t *buf = malloc(LOAD_BUFFER_SIZE);
+    if (!buf)
+        return NULL;
+
+    unsigned pass = 0;
+    while (g_load_running)
+    {
+        memset(buf, (int)(pass++ & 0xFFu), LOAD_BUFFER_SIZE);
+        (void)getppid(); /* cheap syscall: kernel entry/exit traffic */
+    }
+    free(buf);
+    return NULL;
+}
+
+typedef struct
+{
+    size_t packets;
+    unsigned rate_hz;
+    int fd;
+} SenderArgs;
+
+static void *sender_thread(void *arg)
+{
+    SenderArgs *a = (SenderArgs *)arg;
+    const uint64_t period_ns = 1000000000ull / a->rate_hz;
+    uint64_t next_ns = monotonic_now_ns() + period_ns;
+
+    struct sockaddr_in dst;
+    memset(&dst, 0, sizeof(dst));
+    dst.sin_family = AF_INET;
+    dst.sin_port = htons(SOURCE_PORT);
+    dst.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    for (size_t i = 0; i < a->packets; ++i)
+    {
+        struct timespec ts;
+        ts.tv_sec = (time_t)(next_ns / 1000000000ull);
+        ts.tv_nsec = (long)(next_ns % 1000000000ull);
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+            ;
+        next_ns += period_ns;
+
+        /* payload: sequence number, send time; then freshness, priority */
+        uint8_t pkt[INBOUND_PACKET_SIZE];
+        uint64_t seq = i, send_ns = monotonic_now_ns();
+        memset(pkt, 0, sizeof(pkt));
+        memcpy(pkt, &seq, sizeof(seq));
+        memcpy(pkt + 8, &send_ns, sizeof(send_ns));
+        pkt[ACKERMANN_PAYLOAD_SIZE + 2] = 0x03; /* freshness 1000 ms, BE32 */
+        pkt[ACKERMANN_PAYLOAD_SIZE + 3] = 0xE8;
+        pkt[ACKERMANN_PAYLOAD_SIZE + 4] = 100;  /* priority */
+
+        if (sendto(a->fd, pkt, sizeof(pkt), 0, (struct sockaddr *)&dst, sizeof(dst)) < 0)
+            perror("rt_jitter: sendto");
+    }
+    return NULL;
+}
+
+static int open_sink(void)
+{
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+        return -1;
+
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(SINK_PORT);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        close(fd);
+        return -1;
+    }
+
+    struct timeval tv = {1, 0}; /* end of run: give up after 1 s silence */
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+    rx_timestamp_enable(fd);
+    return fd;
+}
+
+static CommandPool g_pool;
+static CommandInterface g_iface;
+static MCULogic g_mcu;
+
+int main(int argc, char **argv)
+{
+    size_t packets = 5000;
+    unsigned rate_hz = 1000;
+    int load_threads = 2;
+    RtConfig rt = {0, {-1, -1, -1}};
+
+    for (int i = 1; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "--rt") == 0)
+            rt.harden = 1;
+        else if (strcmp(argv[i], "-n") == 0 && i + 1 < argc)
+            packets = (size_t)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-f") == 0 && i + 1 < argc)
+            rate_hz = (unsigned)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "-l") == 0 && i + 1 < argc)
+            load_threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-c") == 0 && i + 1 < argc &&
+                 sscanf(argv[i + 1], "%d,%d", &rt.cpu[RT_THREAD_INTERFACE],
+                        &rt.cpu[RT_THREAD_MCU]) == 2)
+            ++i;
+        else
+        {
+            fprintf(stderr, "usage: %s [--rt] [-n packets] [-f rate_hz] [-l load_threads] "
+                            "[-c interface_cpu,mcu_cpu]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (packets == 0 || rate_hz == 0 || load_threads < 0 || load_threads > MAX_LOAD_THREADS)
+    {
+        fprintf(stderr, "rt_jitter: invalid arguments\n");
+        return 1;
+    }
+
+    rt_configure(&rt);
+
+    /* --- The path under test: interface → pool → MCU → sink. --- */
+    int sink = open_sink();
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    if (sink < 0 || tx < 0)
+    {
+        perror("rt_jitter: socket");
+        return 1;
+    }
+
+    InterfaceSourceConfig src = {"jitter", SOURCE_PORT, "127.0.0.1", 255u, 1u, 0u, 0u};
+    MCUTargetConfig tgt = {"sink", "127.0.0.1", SINK_PORT};
+    if (pool_init(&g_pool) != 0 ||
+        interface_init(&g_iface, &src, 1, &g_pool, NULL) != 0 ||
+        mcu_init(&g_mcu, &g_pool, &tgt, 1, NULL) != 0 ||
+        interface_start(&g_iface) != 0 || mcu_start(&g_mcu) != 0)
+    {
+        fprintf(stderr, "rt_jitter: failed to start the command path\n");
+        return 1;
+    }
+
+    /* --- Background load, then the sender. --- */
+    pthread_t load[MAX_LOAD_THREADS], sender;
+    for (int i = 0; i < load_threads; ++i)
+        pthread_create(&load[i], NULL, load_thread, NULL);
+
+    SenderArgs sa = {packets, rate_hz, tx};
+    pthread_create(&sender, NULL, sender_thread, &sa);
+
+    /* --- Collect: send time (in the payload) to the sink's kernel
+     *     receive stamp.                                          --- */
+    uint64_t *samples = malloc(packets * sizeof(uint64_t));
+    LatencyHist hist;
+    lat_hist_init(&hist);
+    size_t received = 0;
+
+    while (received < packets)
+    {
+        uint8_t buf[64];
+        RxControl control;
+        struct iovec iov = {buf, sizeof(buf)};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t n = recvmsg(sink, &msg, 0);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break; /* timeout: the rest were lost */
+        }
+        if ((size_t)n < ACKERMANN_PAYLOAD_SIZE)
+            continue;
+
+        uint64_t now_ns, send_ns;
+        int64_t real_to_mono_ns = rx_real_to_mono_ns(&now_ns);
+        uint64_t rx_ns = rx_timestamp_ns(&msg, real_to_mono_ns, now_ns);
+        memcpy(&send_ns, buf + 8, sizeof(send_ns));
+
+        uint64_t lat = (rx_ns > send_ns) ? rx_ns - send_ns : 0u;
+        samples[received++] = lat;
+        lat_hist_record(&hist, lat);
+    }
+
+    pthread_join(sender, NULL);
+    g_load_running = 0;
+    for (int i = 0; i < load_threads; ++i)
+        pthread_join(load[i], NULL);
+    mcu_stop(&g_mcu);
+    interface_stop(&g_iface);
+
+    /* --- Report. --- */
+    bench_sort(samples, received);
+    lat_hist_print(stderr, "receive->forward", &hist);
+    fprintf(stderr, "sent=%zu received=%zu worst=%.1fus (%s, %d load threads, %u Hz)\n",
+            packets, received,
+            received ? (double)samples[received - 1] / 1e3 : 0.0,
+            rt.harden ? "hardened" : "plain", load_threads, rate_hz);
+
+    printf("{\"bench\":\"rt_jitter\",\"hardened\":%d,\"load_threads\":%d,\"rate_hz\":%u,"
+           "\"sent\":%zu,\"received\":%zu,\"p50_us\":%.1f,\"p99_us\":%.1f,"
+           "\"p999_us\":%.1f,\"max_us\":%.1f}\n",
+           rt.harden, load_threads, rate_hz, packets, received,
+           (double)bench_percentile(samples, received, 0.50) / 1e3,
+           (double)bench_percentile(samples, received, 0.99) / 1e3,
+           (double)bench_percentile(samples, received, 0.999) / 1e3,
+           received ? (double)samples[received - 1] / 1e3 : 0.0);
+
+    free(samples);
+    mcu_destroy(&g_mcu);
+    interface_destroy(&g_iface);
+    pool_destroy(&g_pool);
+    close(tx);
+    close(sink);
+    return (received == packets) ? 0 : 1;
+}
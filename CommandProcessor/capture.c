@@ -0,0 +1,241 @@
+#include "capture.h"
+#include "rt_thread.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Counters have a single writer each; see the matching helpers in
+ * command_pool.c. */
+static inline void stat_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_read(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static inline void put_le16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)v;
+    p[1] = (uint8_t)(v >> 8);
+}
+
+static inline void put_le32(uint8_t *p, uint32_t v)
+{
+    put_le16(p, (uint16_t)v);
+    put_le16(p + 2, (uint16_t)(v >> 16));
+}
+
+static inline void put_le64(uint8_t *p, uint64_t v)
+{
+    for (unsigned i = 0; i < 8u; ++i)
+        p[i] = (uint8_t)(v >> (8u * i));
+}
+
+/* -----------------------------------------------------------------------
+ * Producer side
+ * ----------------------------------------------------------------------- */
+
+void capture_datagram(CaptureRing *ring, uint8_t source, uint64_t rx_ns,
+                      const uint8_t *payload, const uint8_t *trailer, size_t len)
+{
+    if (!ring)
+        return;
+
+    uint32_t head = ring->head; /* only this thread writes head */
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= CAPTURE_RING_CAPACITY)
+    {
+        stat_add(&ring->overflow, 1);
+        return;
+    }
+
+    CaptureRecord *rec = &ring->records[head & (CAPTURE_RING_CAPACITY - 1u)];
+    if (len > CAPTURE_DATAGRAM_MAX)
+        len = CAPTURE_DATAGRAM_MAX;
+    size_t head_len = (len < ACKERMANN_PAYLOAD_SIZE) ? len : ACKERMANN_PAYLOAD_SIZE;
+
+    rec->rx_ns = rx_ns;
+    rec->source = source;
+    rec->len = (uint8_t)len;
+    memcpy(rec->data, payload, head_len);
+    memcpy(rec->data + head_len, trailer, len - head_len);
+
+    stat_add(&ring->captured, 1);
+    __atomic_store_n(&ring->head, head + 1u, __ATOMIC_RELEASE);
+}
+
+/* -----------------------------------------------------------------------
+ * Writer thread
+ * ----------------------------------------------------------------------- */
+
+/* Write everything queued so far in ring.  Returns the number of records
+ * handled. */
+static size_t drain_ring(Capture *cap, CaptureRing *ring)
+{
+    uint32_t tail = ring->tail; /* only this thread writes tail */
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    size_t handled = 0;
+
+    for (; tail != head; ++tail, ++handled)
+    {
+        const CaptureRecord *rec = &ring->records[tail & (CAPTURE_RING_CAPACITY - 1u)];
+        uint8_t buf[CAPTURE_RECORD_HEADER_SIZE + CAPTURE_DATAGRAM_MAX];
+
+        /* Stamps from before the capture opened cannot happen in practice;
+         * clamp rather than wrap if one ever does. */
+        put_le64(buf, rec->rx_ns > cap->start_ns ? rec->rx_ns - cap->start_ns : 0u);
+        buf[8] = rec->source;
+        buf[9] = rec->len;
+        memcpy(buf + CAPTURE_RECORD_HEADER_SIZE, rec->data, rec->len);
+        size_t size = CAPTURE_RECORD_HEADER_SIZE + buf[9];
+
+        /* The cell may be overwritten from here on; only buf is used. */
+        __atomic_store_n(&ring->tail, tail + 1u, __ATOMIC_RELEASE);
+
+        if (fwrite(buf, 1, size, cap->file) != size)
+            stat_add(&ring->write_failed, 1);
+        else
+            stat_add(&ring->written, 1);
+    }
+    return handled;
+}
+
+/* Drain every ring once.  Returns the number of records handled. */
+static size_t drain_all(Capture *cap)
+{
+    size_t handled = 0;
+    for (size_t r = 0; r < cap->ring_count; ++r)
+        handled += drain_ring(cap, &cap->rings[r]);
+
+    if (handled != 0)
+        fflush(cap->file);
+    return handled;
+}
+
+static void *capture_thread(void *arg)
+{
+    Capture *cap = (Capture *)arg;
+    const struct timespec idle = {0, CAPTURE_POLL_INTERVAL_MS * 1000000L};
+
+    /* Same role as the DB logger: best effort, below both real-time
+     * threads, so file I/O never competes with command handling. */
+    rt_thread_enter(RT_THREAD_DBLOG);
+
+    while (cap->running)
+    {
+        if (drain_all(cap) == 0)
+            nanosleep(&idle, NULL);
+    }
+
+    /* Write what the interfaces queued before they stopped. */
+    drain_all(cap);
+    return NULL;
+}
+
+/* -----------------------------------------------------------------------
+ * Public API
+ * ----------------------------------------------------------------------- */
+
+int capture_open(Capture *cap, const char *path,
+                 const CaptureSource *sources, size_t count)
+{
+    if (!cap || !path || (count > 0 && !sources) || count > 255u)
+        return -1;
+
+    memset(cap, 0, sizeof(*cap));
+    cap->file = fopen(path, "wb");
+    if (!cap->file)
+    {
+        fprintf(stderr, "capture_open: %s: %s\n", path, strerror(errno));
+        return -1;
+    }
+    cap->start_ns = monotonic_now_ns();
+
+    uint8_t hdr[CAPTURE_HEADER_SIZE];
+    put_le32(hdr, CAPTURE_MAGIC);
+    put_le16(hdr + 4, CAPTURE_VERSION);
+    put_le16(hdr + 6, (uint16_t)count);
+    put_le64(hdr + 8, cap->start_ns);
+    int ok = fwrite(hdr, 1, sizeof(hdr), cap->file) == sizeof(hdr);
+
+    for (size_t i = 0; i < count && ok; ++i)
+    {
+        uint8_t entry[CAPTURE_SOURCE_SIZE];
+        memset(entry, 0, sizeof(entry));
+        if (sources[i].name)
+            strncpy((char *)entry, sources[i].name, CAPTURE_NAME_LEN);
+        put_le16(entry + CAPTURE_NAME_LEN, sources[i].port);
+        ok = fwrite(entry, 1, sizeof(entry), cap->file) == sizeof(entry);
+    }
+
+    if (!ok || fflush(cap->file) != 0)
+    {
+        fprintf(stderr, "capture_open: %s: writing header: %s\n", path, strerror(errno));
+        fclose(cap->file);
+        cap->file = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+CaptureRing *capture_register(Capture *cap)
+{
+    if (!cap || !cap->file || cap->running || cap->ring_count >= CAPTURE_MAX_RINGS)
+        return NULL;
+    return &cap->rings[cap->ring_count++];
+}
+
+int capture_start(Capture *cap)
+{
+    if (!cap || !cap->file)
+        return -1;
+
+    cap->running = 1;
+    int rc = rt_thread_create(&cap->thread, RT_THREAD_DBLOG, capture_thread, cap);
+    if (rc != 0)
+    {
+        fprintf(stderr, "capture_start: pthread_create failed: %s\n", strerror(rc));
+        cap->running = 0;
+        return -1;
+    }
+    return 0;
+}
+
+void capture_stop(Capture *cap)
+{
+    if (!cap || !cap->running)
+        return;
+
+    cap->running = 0;
+    pthread_join(cap->thread, NULL);
+}
+
+void capture_close(Capture *cap)
+{
+    if (!cap || !cap->file)
+        return;
+
+    fclose(cap->file);
+    cap->file = NULL;
+}
+
+void capture_get_stats(Capture *cap, CaptureStats *out)
+{
+    if (!cap || !out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    for (size_t r = 0; r < cap->ring_count; ++r)
+    {
+        const CaptureRing *ring = &cap->rings[r];
+        out->captured += stat_read(&ring->captured);
+        out->overflow += stat_read(&ring->overflow);
+        out->written += stat_read(&ring->written);
+        out->write_failed += stat_read(&ring->write_failed);
+    }
+}
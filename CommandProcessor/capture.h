@@ -0,0 +1,140 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <pthread.h>
+
+#include "command_pool.h"
+
+/* -----------------------------------------------------------------------
+ * Capture — record inbound command traffic for later replay.
+ *
+ * When enabled, each interface thread copies every datagram it receives
+ * (valid or not) together with its kernel receive timestamp and source id
+ * into its own single-producer / single-consumer ring, exactly like a DB
+ * log record: a copy and one release store, no syscall.  A full ring
+ * drops the record and counts it.  A low-priority writer thread drains
+ * every ring into one capture file every CAPTURE_POLL_INTERVAL_MS.
+ *
+ * File format (all integers little-endian):
+ *
+ *   File header
+ *     0   4   magic          CAPTURE_MAGIC ("CPCP")
+ *     4   2   version        CAPTURE_VERSION
+ *     6   2   source_count   entries in the source table that follows
+ *     8   8   start_ns       CLOCK_MONOTONIC time the capture was opened
+ *   Source table, source_count entries of CAPTURE_SOURCE_SIZE bytes
+ *     0  16   name           NUL-padded source name
+ *    16   2   port           UDP port the source was received on
+ *   Records, until end of file; in receive order per ring, but records
+ *   of different rings (channels) interleave, so readers sort by rx_ns
+ *     0   8   rx_ns          receive time relative to start_ns
+ *     8   1   source         index into the source table
+ *     9   1   len            datagram bytes that follow
+ *    10 len   datagram       payload and trailer as received
+ *
+ * cp_replay (tools/cp_replay.c) reads this format back.
+ * ----------------------------------------------------------------------- */
+
+#define CAPTURE_MAGIC 0x50435043u /* "CPCP" read little-endian */
+#define CAPTURE_VERSION 1u
+
+/* Largest datagram kept: a version 2 packet plus the one spare byte the
+ * receive path uses to detect oversized datagrams. */
+#define CAPTURE_DATAGRAM_MAX (INBOUND_V2_PACKET_SIZE + 1u)
+
+#define CAPTURE_HEADER_SIZE 16u
+#define CAPTURE_NAME_LEN 16u
+#define CAPTURE_SOURCE_SIZE (CAPTURE_NAME_LEN + 2u)
+#define CAPTURE_RECORD_HEADER_SIZE 10u
+
+/* Records buffered between an interface and the writer thread.  Must be
+ * a power of two; at 1 kHz it holds about 4 s of traffic. */
+#define CAPTURE_RING_CAPACITY 4096u
+
+/* Most producer threads (rings) one capture serves. */
+#define CAPTURE_MAX_RINGS 4u
+
+/* How long the writer thread sleeps when the ring is empty. */
+#define CAPTURE_POLL_INTERVAL_MS 10L
+
+/* One entry of the source table written to the file header. */
+typedef struct
+{
+    const char *name;
+    uint16_t port;
+} CaptureSource;
+
+/* One captured datagram, as queued by the interface thread. */
+typedef struct
+{
+    uint64_t rx_ns; /* CLOCK_MONOTONIC kernel receive time */
+    uint8_t source;
+    uint8_t len;
+    uint8_t data[CAPTURE_DATAGRAM_MAX];
+} CaptureRecord;
+
+/* Counters; read a snapshot with capture_get_stats(). */
+typedef struct
+{
+    uint64_t captured;     /* records queued by the interface threads   */
+    uint64_t overflow;     /* records dropped because a ring was full   */
+    uint64_t written;      /* records written to the file               */
+    uint64_t write_failed; /* records lost to a write error             */
+} CaptureStats;
+
+/* One producer's ring. */
+typedef struct
+{
+    CaptureRecord records[CAPTURE_RING_CAPACITY];
+    uint32_t head __attribute__((aligned(POOL_CACHE_LINE))); /* producer */
+    uint64_t captured;                                      /* producer */
+    uint64_t overflow;                                      /* producer */
+    uint32_t tail __attribute__((aligned(POOL_CACHE_LINE))); /* writer   */
+    uint64_t written;                                       /* writer   */
+    uint64_t write_failed;                                  /* writer   */
+} CaptureRing;
+
+typedef struct
+{
+    CaptureRing rings[CAPTURE_MAX_RINGS];
+    size_t ring_count;
+
+    FILE *file;
+    uint64_t start_ns;
+    pthread_t thread;
+    volatile int running;
+} Capture;
+
+/* Create path and write the file header with the given source table (at
+ * most 255 entries).  Does not start the writer thread. */
+int capture_open(Capture *cap, const char *path,
+                 const CaptureSource *sources, size_t count);
+
+/* Hand out a ring for one producer thread.  Call after capture_open()
+ * and before capture_start().  Returns NULL once CAPTURE_MAX_RINGS rings
+ * are taken. */
+CaptureRing *capture_register(Capture *cap);
+
+/* Start the writer thread. */
+int capture_start(Capture *cap);
+
+/* Stop the writer thread after it has written everything queued. */
+void capture_stop(Capture *cap);
+
+/* Flush and close the file. */
+void capture_close(Capture *cap);
+
+/* Queue one datagram of len bytes received from source at rx_ns.  The
+ * receive path scatters datagrams, so the bytes are passed as the payload
+ * part (the first ACKERMANN_PAYLOAD_SIZE bytes) and the trailer part.
+ * Owning thread only; a NULL ring discards the datagram. */
+void capture_datagram(CaptureRing *ring, uint8_t source, uint64_t rx_ns,
+                      const uint8_t *payload, const uint8_t *trailer, size_t len);
+
+/* Copy the current counters into *out.  Safe from any thread. */
+void capture_get_stats(Capture *cap, CaptureStats *out);
+
+#endif /* CAPTURE_H */
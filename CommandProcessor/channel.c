@@ -0,0 +1,207 @@
+#include "channel.h"
+
+#include <string.h>
+
+_Static_assert(DBLOG_MAX_RINGS >= 2u * CHANNEL_MAX, "channel: two DB log rings per channel");
+
+/* -----------------------------------------------------------------------
+ * Public API
+ * ----------------------------------------------------------------------- */
+
+int channel_init(Channel *ch, const ChannelConfig *cfg, DbLogger *log)
+{
+    if (!ch || !cfg || !cfg->name)
+        return -1;
+
+    memset(ch, 0, sizeof(*ch));
+    ch->cfg = *cfg;
+
+    /* --- Pool. --- */
+    if (pool_init(&ch->pool) != 0)
+    {
+        fprintf(stderr, "channel_init: %s: failed to initialise command pool\n", cfg->name);
+        return -1;
+    }
+    pool_set_coalesce(&ch->pool, cfg->coalesce);
+    pool_set_overload_policy(&ch->pool, cfg->overload);
+    pool_set_sched_policy(&ch->pool, cfg->sched);
+    pool_set_aging_step(&ch->pool, (uint64_t)cfg->aging_step_ms * 1000000ull);
+    for (size_t i = 0; i < cfg->source_count && i < POOL_MAX_SOURCES; ++i)
+        pool_set_source_weight(&ch->pool, (uint8_t)i, cfg->sources[i].wfq_weight);
+
+    /* --- Interface (inbound UDP). --- */
+    DbLogRing *iface_log = log ? dblog_register(log) : NULL;
+    DbLogRing *mcu_log = log ? dblog_register(log) : NULL;
+    if (log && (!iface_log || !mcu_log))
+        fprintf(stderr, "channel_init: %s: no DB log ring left, not logging\n", cfg->name);
+
+    if (interface_init(&ch->iface, cfg->sources, cfg->source_count, &ch->pool, iface_log) != 0)
+    {
+        fprintf(stderr, "channel_init: %s: failed to initialise command interface\n", cfg->name);
+        pool_destroy(&ch->pool);
+        return -1;
+    }
+    interface_set_thread(&ch->iface, &cfg->interface_thread);
+
+    /* --- MCU logic (outbound UDP + scheduling). --- */
+    if (mcu_init(&ch->mcu, &ch->pool, cfg->targets, cfg->target_count, mcu_log) != 0)
+    {
+        fprintf(stderr, "channel_init: %s: failed to initialise MCU logic\n", cfg->name);
+        interface_destroy(&ch->iface);
+        pool_destroy(&ch->pool);
+        return -1;
+    }
+    mcu_set_thread(&ch->mcu, &cfg->mcu_thread);
+    if (mcu_set_rate(&ch->mcu, cfg->tick_rate_hz) != 0 ||
+        mcu_set_ack(&ch->mcu, cfg->ack_timeout_ms) != 0 ||
+        mcu_set_watchdog(&ch->mcu, cfg->watchdog_ms, cfg->stop_payload) != 0)
+    {
+        fprintf(stderr, "channel_init: %s: invalid tick rate, ack or watchdog setting\n",
+                cfg->name);
+        mcu_destroy(&ch->mcu);
+        interface_destroy(&ch->iface);
+        pool_destroy(&ch->pool);
+        return -1;
+    }
+
+    ch->ready = 1;
+    return 0;
+}
+
+int channel_start(Channel *ch)
+{
+    if (!ch || !ch->ready || ch->started)
+        return -1;
+
+    if (interface_start(&ch->iface) != 0)
+    {
+        fprintf(stderr, "channel_start: %s: failed to start command interface thread\n",
+                ch->cfg.name);
+        return -1;
+    }
+    if (mcu_start(&ch->mcu) != 0)
+    {
+        fprintf(stderr, "channel_start: %s: failed to start MCU logic thread\n", ch->cfg.name);
+        interface_stop(&ch->iface);
+        return -1;
+    }
+
+    ch->started = 1;
+    return 0;
+}
+
+void channel_stop(Channel *ch)
+{
+    if (!ch || !ch->started)
+        return;
+
+    interface_stop(&ch->iface);
+    mcu_stop(&ch->mcu);
+    ch->started = 0;
+}
+
+void channel_destroy(Channel *ch)
+{
+    if (!ch || !ch->ready)
+        return;
+
+    channel_stop(ch);
+    mcu_destroy(&ch->mcu);
+    interface_destroy(&ch->iface);
+    pool_destroy(&ch->pool);
+    ch->ready = 0;
+}
+
+void channel_get_stats(Channel *ch, ChannelStats *out)
+{
+    if (!ch || !out)
+        return;
+
+    memset(out, 0, sizeof(*out));
+    if (!ch->ready)
+        return;
+
+    PoolStats ps;
+    pool_get_stats(&ch->pool, &ps);
+    out->dropped = ps.dropped_full + ps.evicted;
+    out->expired = ps.expired;
+    out->depth = ps.depth;
+    out->depth_hwm = ps.depth_hwm;
+
+    for (size_t i = 0; i < ch->iface.source_count; ++i)
+    {
+        InterfaceSourceStats ss;
+        interface_get_source_stats(&ch->iface, i, &ss);
+        out->received += ss.received;
+        out->throttled += ss.throttled;
+        out->dropped += ss.dropped;
+    }
+
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+    {
+        LatencyHist snap;
+        lat_hist_snapshot(&ch->mcu.latency[p], &snap);
+        out->forwarded += snap.count;
+    }
+}
+
+void channel_print_stats(Channel *ch, FILE *out)
+{
+    if (!ch || !out || !ch->ready)
+        return;
+
+    PoolStats stats;
+    pool_get_stats(&ch->pool, &stats);
+    fprintf(out, "Channel %s pool: pushed=%llu popped=%llu ingress_full=%llu dropped_full=%llu "
+                 "evicted=%llu expired=%llu coalesced=%llu depth_hwm=%llu\n",
+            ch->cfg.name,
+            (unsigned long long)stats.pushed,
+            (unsigned long long)stats.popped,
+            (unsigned long long)stats.ingress_full,
+            (unsigned long long)stats.dropped_full,
+            (unsigned long long)stats.evicted,
+            (unsigned long long)stats.expired,
+            (unsigned long long)stats.coalesced,
+            (unsigned long long)stats.depth_hwm);
+    for (unsigned p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+    {
+        if (stats.dropped_by_priority[p] != 0)
+            fprintf(out, "Channel %s pool: priority %u dropped=%llu\n", ch->cfg.name, p,
+                    (unsigned long long)stats.dropped_by_priority[p]);
+    }
+
+    for (size_t i = 0; i < ch->iface.source_count; ++i)
+    {
+        InterfaceSourceStats ss;
+        if (interface_get_source_stats(&ch->iface, i, &ss) != 0)
+            continue;
+        fprintf(out, "Source %s: received=%llu malformed=%llu throttled=%llu clamped=%llu "
+                     "pushed=%llu dropped=%llu legacy=%llu gaps=%llu reordered=%llu "
+                     "duplicates=%llu seq_resets=%llu errors=%llu\n",
+                ch->iface.sources[i].cfg.name,
+                (unsigned long long)ss.received,
+                (unsigned long long)ss.malformed,
+                (unsigned long long)ss.throttled,
+                (unsigned long long)ss.clamped,
+                (unsigned long long)ss.pushed,
+                (unsigned long long)ss.dropped,
+                (unsigned long long)ss.legacy,
+                (unsigned long long)ss.gaps,
+                (unsigned long long)ss.reordered,
+                (unsigned long long)ss.duplicates,
+                (unsigned long long)ss.seq_resets,
+                (unsigned long long)ss.errors);
+    }
+
+    for (size_t t = 0; t < ch->mcu.target_count; ++t)
+    {
+        MCUTargetStats ts;
+        if (mcu_get_target_stats(&ch->mcu, t, &ts) != 0)
+            continue;
+        fprintf(out, "Target %s: sent=%llu dropped=%llu errors=%llu\n",
+                ch->mcu.targets[t].cfg.name,
+                (unsigned long long)ts.sent,
+                (unsigned long long)ts.dropped,
+                (unsigned long long)ts.errors);
+    }
+}
@@ -0,0 +1,103 @@
+#ifndef CHANNEL_H
+#define CHANNEL_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "command_interface.h"
+#include "command_pool.h"
+#include "db_logger.h"
+#include "mcu_logic.h"
+#include "rt_thread.h"
+
+/* -----------------------------------------------------------------------
+ * Channel — one independent command path.
+ *
+ * A channel owns a set of inbound sources, its own command pool, a
+ * receive (interface) thread, a scheduling (MCU) thread and the targets
+ * it forwards to.  Channels share nothing on the command path: a flood
+ * on one channel can only fill that channel's pool and ingress ring, and
+ * each channel's threads run at their own priority, optionally pinned to
+ * their own CPU, so e.g. steering/throttle can outrank auxiliary
+ * actuators and lights.  Only the best-effort side is shared: the DB
+ * logger and traffic capture, through one ring per channel thread.
+ *
+ * Channels are built by main.c from its g_channels[] table.
+ * ----------------------------------------------------------------------- */
+
+/* Most channels one process runs.  Each takes two DB log rings and one
+ * capture ring. */
+#define CHANNEL_MAX 4u
+
+/* One entry of the channel table. */
+typedef struct
+{
+    const char *name;                     /* label used in logs and stats  */
+    const InterfaceSourceConfig *sources; /* see interface_init()          */
+    size_t source_count;
+    const MCUTargetConfig *targets;       /* see mcu_init()                */
+    size_t target_count;
+
+    /* Pool — see the pool_set_*() calls. */
+    PoolCoalesceMode coalesce;
+    PoolOverloadPolicy overload;
+    PoolSchedPolicy sched;
+    uint32_t aging_step_ms;
+
+    /* Forwarding — see the mcu_set_*() calls. */
+    uint32_t tick_rate_hz;         /* 0 = event-driven                    */
+    uint32_t ack_timeout_ms;       /* 0 = no ack channel                  */
+    uint32_t watchdog_ms;          /* 0 = no silence watchdog             */
+    const uint8_t *stop_payload;   /* ACKERMANN_PAYLOAD_SIZE bytes        */
+
+    /* Thread priority and CPU, per thread (see RtThreadSched). */
+    RtThreadSched interface_thread;
+    RtThreadSched mcu_thread;
+} ChannelConfig;
+
+/* Channel totals; read a snapshot with channel_get_stats(). */
+typedef struct
+{
+    uint64_t received;  /* datagrams read, all sources                */
+    uint64_t throttled; /* dropped by a source's rate limit           */
+    uint64_t dropped;   /* valid commands lost: no slot, ring or pool
+                           full, or evicted                           */
+    uint64_t expired;   /* discarded past their deadline              */
+    uint64_t forwarded; /* sent to the primary target                 */
+    uint64_t depth;     /* commands queued now                        */
+    uint64_t depth_hwm;
+} ChannelStats;
+
+typedef struct
+{
+    ChannelConfig cfg;
+    CommandPool pool;
+    CommandInterface iface;
+    MCULogic mcu;
+    int ready;   /* channel_init() succeeded         */
+    int started; /* both threads are running         */
+} Channel;
+
+/* Initialise the pool, interface and MCU logic of ch from cfg (does NOT
+ * start threads).  Each thread gets its own ring of log (may be NULL).
+ * The table is copied; its arrays and strings must outlive the channel.
+ * Returns 0, or -1 with nothing left to destroy. */
+int channel_init(Channel *ch, const ChannelConfig *cfg, DbLogger *log);
+
+/* Start the interface and MCU threads. */
+int channel_start(Channel *ch);
+
+/* Stop both threads, if running, and join them. */
+void channel_stop(Channel *ch);
+
+/* Release all resources.  Safe on a channel that failed to initialise. */
+void channel_destroy(Channel *ch);
+
+/* Copy the channel totals into *out.  Safe from any thread. */
+void channel_get_stats(Channel *ch, ChannelStats *out);
+
+/* Print the pool, source and target counters.  Safe from any thread. */
+void channel_print_stats(Channel *ch, FILE *out);
+
+#endif /* CHANNEL_H */
@@ -1,17 +1,23 @@
+#define _GNU_SOURCE /* recvmmsg on glibc */
 #include "command_interface.h"
+#include "rt_thread.h"
+#include "rx_timestamp.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <mqueue.h>
+#include <poll.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
-// Define the global mqd
-mqd_t mqd;
+/* Batched receive is available on Linux and QNX 7+; elsewhere fall back
+ * to one recvfrom per datagram. */
+#if defined(__linux__) || defined(__QNXNTO__)
+#define INTERFACE_HAVE_RECVMMSG 1
+#endif
 
 /* -----------------------------------------------------------------------
  * Wire-format helpers
@@ -21,89 +27,398 @@ mqd_t mqd;
  *   Offset  Size  Field
  *   ------  ----  -----
  *   0       16    ackermann_payload  (opaque)
- *   16       1    priority           (uint8_t)
+ *   16       4    freshness_ms       (uint32_t)
+ *   20       1    priority           (uint8_t)
+ *   21       1    version            (uint8_t, 2)       \
+ *   22       1    flags              (uint8_t)           | version 2
+ *   23       4    seq                (uint32_t)          | only
+ *   27       8    sender_ts_ns       (uint64_t)         /
+ *
+ * Total: INBOUND_V2_PACKET_SIZE (35) bytes, or INBOUND_PACKET_SIZE (21)
+ * for unsequenced packets.
+ *
+ * Legacy packets of INBOUND_LEGACY_PACKET_SIZE (17) bytes carry the
+ * priority at offset 16 and no freshness; they never expire.
  *
- * Total: INBOUND_PACKET_SIZE (17) bytes.
+ * Datagrams are scattered on receive: the payload lands directly in its
+ * pool slot and everything after it (the trailer) in a small side
+ * buffer, so the offsets below are relative to the end of the payload.
  * ----------------------------------------------------------------------- */
 
-#define PRIORITY_OFFSET ACKERMANN_PAYLOAD_SIZE
+#define TRAILER_SIZE (INBOUND_V2_PACKET_SIZE - ACKERMANN_PAYLOAD_SIZE)
+#define FRESHNESS_OFFSET 0u
+#define PRIORITY_OFFSET 4u
+#define VERSION_OFFSET 5u
+#define FLAGS_OFFSET 6u
+#define SEQ_OFFSET 7u
+#define SENDER_TS_OFFSET 11u
+#define LEGACY_PRIORITY_OFFSET 0u
+
+static inline uint32_t read_be32(const uint8_t *p)
+{
+    return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) |
+           ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+static inline uint64_t read_be64(const uint8_t *p)
+{
+    return ((uint64_t)read_be32(p) << 32) | (uint64_t)read_be32(p + 4);
+}
+
+/* Per-source counters have a single writer (the receive thread); see the
+ * matching helpers in command_pool.c. */
+static inline void stat_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_read(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/*
+ * Sequence check for a version 2 command from src.  Accepts seq if it is
+ * newer than the last accepted one, counting any skipped numbers as a
+ * gap.  A seq that is not newer is a duplicate or a late reordering —
+ * unless the sender flagged a reset or its timestamp is newer than that
+ * of the last accepted command, which means the sender restarted and the
+ * sequence starts over.  Returns 0 to accept, -1 to drop.
+ */
+static int seq_accept(InterfaceSource *src, uint32_t seq, uint8_t flags,
+                      uint64_t sender_ts_ns)
+{
+    /* Serial-number comparison, so the counter may wrap. */
+    int32_t diff = (int32_t)(seq - src->last_seq);
+
+    if (!src->have_seq)
+    {
+        /* First sequenced command from this source. */
+    }
+    else if (flags & INBOUND_FLAG_SEQ_RESET ||
+             (diff <= 0 && sender_ts_ns > src->last_sender_ts_ns))
+    {
+        stat_add(&src->stats.seq_resets, 1);
+    }
+    else if (diff == 0)
+    {
+        stat_add(&src->stats.duplicates, 1);
+        return -1;
+    }
+    else if (diff < 0)
+    {
+        stat_add(&src->stats.reordered, 1);
+        return -1;
+    }
+    else if (diff > 1)
+    {
+        stat_add(&src->stats.gaps, (uint64_t)diff - 1u);
+    }
+
+    src->have_seq = 1;
+    src->last_seq = seq;
+    src->last_sender_ts_ns = sender_ts_ns;
+    return 0;
+}
+
+/* Token-bucket check for one datagram from src received at recv_ns.
+ * Returns 1 if it conforms (and takes its token), 0 if it must be
+ * dropped.  rate_tat_ns is when the bucket will be full again: each
+ * accepted datagram moves it one interval on, and a datagram is over the
+ * limit when that lies more than the burst headroom ahead of it. */
+static inline int rate_admit(InterfaceSource *src, uint64_t recv_ns)
+{
+    if (src->rate_interval_ns == 0)
+        return 1;
+
+    uint64_t tat = (src->rate_tat_ns > recv_ns) ? src->rate_tat_ns : recv_ns;
+    if (tat - recv_ns > src->rate_tolerance_ns)
+    {
+        stat_add(&src->stats.throttled, 1);
+        return 0;
+    }
+    src->rate_tat_ns = tat + src->rate_interval_ns;
+    return 1;
+}
+
+/*
+ * Validate one datagram of n bytes from source index id, given its
+ * trailer, and fill in the metadata of its pool entry — the ackermann
+ * bytes are already in place and stay opaque.  Returns 0 on success, -1
+ * if the datagram must be dropped.
+ */
+static int parse_datagram(CommandInterface *iface, uint8_t id, const uint8_t *trailer,
+                          size_t n, uint64_t recv_ns, int64_t real_to_mono_ns,
+                          PoolEntry *entry)
+{
+    InterfaceSource *src = &iface->sources[id];
+
+    if ((n != INBOUND_V2_PACKET_SIZE && n != INBOUND_PACKET_SIZE &&
+         n != INBOUND_LEGACY_PACKET_SIZE) ||
+        (n == INBOUND_V2_PACKET_SIZE && trailer[VERSION_OFFSET] != INBOUND_VERSION_2))
+    {
+        /* Counted only: stdio on this thread would stall it behind the
+         * console under a flood of bad datagrams. */
+        stat_add(&src->stats.malformed, 1);
+        return -1;
+    }
+
+    /* --- Drop duplicates and stale reorderings before anything else. --- */
+    if (n == INBOUND_V2_PACKET_SIZE)
+    {
+        uint64_t sender_ts_ns = read_be64(&trailer[SENDER_TS_OFFSET]);
+        if (seq_accept(src, read_be32(&trailer[SEQ_OFFSET]), trailer[FLAGS_OFFSET],
+                       sender_ts_ns) != 0)
+            return -1;
+
+        /* Both ends on CLOCK_REALTIME; a negative transit means the
+         * clocks disagree and is not recorded. */
+        int64_t recv_real_ns = (int64_t)recv_ns - real_to_mono_ns;
+        int64_t transit_ns = recv_real_ns - (int64_t)sender_ts_ns;
+        if (transit_ns >= 0)
+            lat_hist_record(&src->transit, (uint64_t)transit_ns);
+    }
+    else
+    {
+        stat_add(&src->stats.legacy, 1);
+    }
+
+    /* --- Parse freshness and priority. --- */
+    uint32_t freshness_ms = 0;
+    uint8_t priority;
+    if (n != INBOUND_LEGACY_PACKET_SIZE)
+    {
+        freshness_ms = read_be32(&trailer[FRESHNESS_OFFSET]);
+        priority = trailer[PRIORITY_OFFSET];
+    }
+    else
+    {
+        priority = trailer[LEGACY_PRIORITY_OFFSET];
+    }
+
+    /* --- Enforce the source's priority ceiling. --- */
+    if (priority > src->cfg.priority_ceiling)
+    {
+        priority = src->cfg.priority_ceiling;
+        stat_add(&src->stats.clamped, 1);
+    }
+
+    /* --- Queue the database record; formatted by the logger thread. --- */
+    DbLogRecord rec;
+    rec.source = src->cfg.name;
+    rec.time_ns = recv_ns;
+    rec.freshness_ms = freshness_ms;
+    rec.latency_ns = 0;
+    rec.kind = DBLOG_RECEIVED;
+    rec.priority = priority;
+    dblog_write(iface->log, &rec);
+
+    entry->priority = priority;
+    entry->source = id;
+    entry->recv_ns = recv_ns;
+    entry->valid_until_ns = (freshness_ms == 0)
+                                ? POOL_NO_DEADLINE
+                                : entry->recv_ns + (uint64_t)freshness_ms * 1000000ull;
+    return 0;
+}
 
 /* -----------------------------------------------------------------------
  * Receive thread
+ *
+ * One poll() over every source socket plus the wake pipe.  Each pass
+ * gives every readable source one batch: up to INTERFACE_BATCH_MAX
+ * datagrams pulled with a single non-blocking recvmmsg call (one recvmsg
+ * where unavailable), validated in a tight loop and published to the
+ * pool with one pool_commit.  The source served first rotates from pass
+ * to pass, so no source is always behind another for ring space.
+ *
+ * Receive is zero-copy: the thread keeps a stash of pool slots reserved
+ * ahead of time and points each datagram's first iovec at a slot's
+ * ackermann_bytes, so the kernel writes the payload straight into the
+ * entry the MCU thread will pop.  Only the trailer goes to a side buffer.
+ * A slot whose datagram turns out invalid stays in the stash for reuse.
  * ----------------------------------------------------------------------- */
 
-static void *interface_thread(void *arg)
+/* Receive state, reused for every source.  One spare trailer byte per
+ * datagram so oversized datagrams are detected, not truncated. */
+typedef struct
 {
-    CommandInterface *iface = (CommandInterface *)arg;
-    uint8_t buf[INBOUND_PACKET_SIZE];
+    uint16_t slots[INTERFACE_BATCH_MAX]; /* reserved pool slots        */
+    size_t reserved;                     /* valid entries in slots[]   */
+    uint8_t trailers[INTERFACE_BATCH_MAX][TRAILER_SIZE + 1];
+    uint8_t scratch[INTERFACE_BATCH_MAX][ACKERMANN_PAYLOAD_SIZE]; /* no slot */
+    struct sockaddr_in from[INTERFACE_BATCH_MAX];
+    RxControl control[INTERFACE_BATCH_MAX];
+    struct iovec iov[INTERFACE_BATCH_MAX][2];
+#ifdef INTERFACE_HAVE_RECVMMSG
+    struct mmsghdr msgs[INTERFACE_BATCH_MAX];
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+    } msgs[1];
+#endif
+} RxBatch;
 
-    // Open message queue to write
-    mqd = mq_open("/db_queue", O_WRONLY | O_NONBLOCK);
-    if (mqd == (mqd_t)-1)
+#define RX_BATCH_SLOTS(rx) (sizeof((rx)->msgs) / sizeof((rx)->msgs[0]))
+
+static void rx_batch_init(RxBatch *rx)
+{
+    memset(rx, 0, sizeof(*rx));
+    for (size_t i = 0; i < RX_BATCH_SLOTS(rx); ++i)
     {
-        perror("mq_open");
-        return NULL;
+        rx->iov[i][0].iov_len = ACKERMANN_PAYLOAD_SIZE;
+        rx->iov[i][1].iov_base = rx->trailers[i];
+        rx->iov[i][1].iov_len = sizeof(rx->trailers[i]);
+        rx->msgs[i].msg_hdr.msg_iov = rx->iov[i];
+        rx->msgs[i].msg_hdr.msg_iovlen = 2;
+        rx->msgs[i].msg_hdr.msg_name = &rx->from[i];
+        rx->msgs[i].msg_hdr.msg_control = rx->control[i].buf;
     }
+}
 
-    while (iface->running)
+/* Take one batch from source index id and push it to the pool. */
+static void receive_batch(CommandInterface *iface, size_t id, RxBatch *rx)
+{
+    InterfaceSource *src = &iface->sources[id];
+    size_t lens[INTERFACE_BATCH_MAX];
+    int received;
+
+    /* --- Top up the slot stash and aim each datagram's payload at its
+     *     slot.  Without a free slot the payload goes to scratch and the
+     *     command is dropped below.                                  --- */
+    if (rx->reserved < RX_BATCH_SLOTS(rx))
+        rx->reserved += pool_reserve(iface->pool, rx->slots + rx->reserved,
+                                     RX_BATCH_SLOTS(rx) - rx->reserved);
+
+    for (size_t i = 0; i < RX_BATCH_SLOTS(rx); ++i)
+    {
+        rx->iov[i][0].iov_base = (i < rx->reserved)
+                                     ? pool_slot_entry(iface->pool, rx->slots[i])->ackermann_bytes
+                                     : rx->scratch[i];
+
+        /* The kernel overwrites these on every receive. */
+        rx->msgs[i].msg_hdr.msg_namelen = sizeof(rx->from[i]);
+        rx->msgs[i].msg_hdr.msg_controllen = sizeof(rx->control[i].buf);
+    }
+
+#ifdef INTERFACE_HAVE_RECVMMSG
+    received = recvmmsg(src->sock_fd, rx->msgs, INTERFACE_BATCH_MAX,
+                        MSG_DONTWAIT, NULL);
+    if (received > 0)
+    {
+        for (int i = 0; i < received; ++i)
+            lens[i] = rx->msgs[i].msg_len;
+    }
+#else
+    ssize_t n = recvmsg(src->sock_fd, &rx->msgs[0].msg_hdr, MSG_DONTWAIT);
+    received = (n < 0) ? -1 : 1;
+    if (n >= 0)
+        lens[0] = (size_t)n;
+#endif
+
+    if (received < 0)
+    {
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+            stat_add(&src->stats.errors, 1);
+        return;
+    }
+    stat_add(&src->stats.received, (uint64_t)received);
+
+    /* --- Map the kernel RX stamps onto CLOCK_MONOTONIC.  "now" is
+     *     also the fallback for datagrams that carry no stamp.  --- */
+    uint64_t now_ns;
+    int64_t real_to_mono_ns = rx_real_to_mono_ns(&now_ns);
+
+    /* --- Split the used slots into valid commands (to commit) and
+     *     rejects, which go back into the stash.                  --- */
+    uint16_t commit[INTERFACE_BATCH_MAX];
+    size_t valid = 0, kept = 0, no_slot = 0;
+    for (int i = 0; i < received; ++i)
     {
-        ssize_t n = recv(iface->sock_fd, buf, sizeof(buf), 0);
+        uint64_t recv_ns = rx_timestamp_ns(&rx->msgs[i].msg_hdr, real_to_mono_ns, now_ns);
+        capture_datagram(iface->capture, (uint8_t)(iface->capture_base + id), recv_ns,
+                         rx->iov[i][0].iov_base, rx->trailers[i], lens[i]);
 
-        if (n < 0)
+        if (!rate_admit(src, recv_ns))
         {
-            if (errno == EINTR)
-                continue; /* interrupted — retry              */
-            if (!iface->running)
-                break; /* shutdown path                    */
-            perror("interface_thread: recv");
+            if ((size_t)i < rx->reserved)
+                rx->slots[kept++] = rx->slots[i];
             continue;
         }
 
-        if ((size_t)n != INBOUND_PACKET_SIZE)
+        if ((size_t)i >= rx->reserved)
         {
-            fprintf(stderr,
-                    "interface_thread: unexpected packet size %zd (expected %u), dropping\n",
-                    n, (unsigned)INBOUND_PACKET_SIZE);
+            no_slot++;
             continue;
         }
 
-        /* --- Timestamp the arrival as early as possible. --- */
-        struct timespec recv_time;
-        clock_gettime(CLOCK_MONOTONIC, &recv_time);
+        uint16_t slot = rx->slots[i];
+        if (parse_datagram(iface, (uint8_t)id, rx->trailers[i], lens[i], recv_ns,
+                           real_to_mono_ns, pool_slot_entry(iface->pool, slot)) == 0)
+            commit[valid++] = slot;
+        else
+            rx->slots[kept++] = slot;
+    }
+    for (size_t i = (size_t)received; i < rx->reserved; ++i)
+        rx->slots[kept++] = rx->slots[i];
+    rx->reserved = kept;
+
+    size_t pushed = pool_commit(iface->pool, commit, valid);
+    size_t dropped = (valid - pushed) + no_slot;
+    stat_add(&src->stats.pushed, pushed);
+    if (dropped > 0)
+        stat_add(&src->stats.dropped, dropped);
+}
 
-        /* --- Parse priority. --- */
-        uint8_t priority = buf[PRIORITY_OFFSET];
+static void *interface_thread(void *arg)
+{
+    CommandInterface *iface = (CommandInterface *)arg;
+    RxBatch rx; /* one per receive thread: each channel has its own */
+    struct pollfd fds[INTERFACE_MAX_SOURCES + 1];
+    const size_t nsrc = iface->source_count;
+    size_t first = 0;
 
-        // ADD DATABASE ENTRY HERE THAT WILL STORE CMD, PRIORITY, AND RECEIVE TIME
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table)); // "sensors", "states", or "logs"
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        snprintf(msg.msg, sizeof(msg.msg), "Command Received: Priority: %u Time: %ld.%09ld",
-                 priority,
-                 recv_time.tv_sec,
-                 recv_time.tv_nsec);
+    rt_thread_enter_sched(RT_THREAD_INTERFACE, &iface->thread_sched);
+    rx_batch_init(&rx);
 
-        if (mq_send(mqd, (char *)&msg, sizeof(DB_t), 0) == -1)
-        {
-            perror("mq_send");
-        }
-        else
+    for (size_t i = 0; i < nsrc; ++i)
+    {
+        fds[i].fd = iface->sources[i].sock_fd;
+        fds[i].events = POLLIN;
+    }
+    fds[nsrc].fd = iface->wake_pipe[0];
+    fds[nsrc].events = POLLIN;
+
+    while (iface->running)
+    {
+        int ready = poll(fds, (nfds_t)(nsrc + 1), -1);
+
+        if (!iface->running)
+            break; /* shutdown path                    */
+
+        if (ready < 0)
         {
-            printf("Sent to DB: table=%s id=%s msg=%s\n", msg.table, msg.id, msg.msg);
+            if (errno == EINTR)
+                continue; /* interrupted — retry              */
+            /* Counted against every source it was waiting for. */
+            for (size_t i = 0; i < nsrc; ++i)
+                stat_add(&iface->sources[i].stats.errors, 1);
+            continue;
         }
 
-        /* --- Build the pool entry (ackermann bytes stay opaque). --- */
-        PoolEntry entry;
-        memcpy(entry.ackermann_bytes, buf, ACKERMANN_PAYLOAD_SIZE);
-        entry.priority = priority;
-
-        if (pool_push(iface->pool, &entry) != 0)
+        for (size_t k = 0; k < nsrc; ++k)
         {
-            fprintf(stderr, "interface_thread: pool_push failed, command dropped\n");
+            size_t i = (first + k) % nsrc;
+            if (fds[i].revents & (POLLIN | POLLERR))
+                receive_batch(iface, i, &rx);
         }
+        first = (first + 1) % nsrc;
     }
 
-    mq_close(mqd);
+    /* Hand the stashed slots back. */
+    pool_cancel(iface->pool, rx.slots, rx.reserved);
+    rx.reserved = 0;
     return NULL;
 }
 
@@ -111,66 +426,135 @@ static void *interface_thread(void *arg)
  * Public API
  * ----------------------------------------------------------------------- */
 
-int interface_init(CommandInterface *iface, uint16_t listen_port,
-                   CommandPool *pool)
+/* Open and bind the socket of one source.  Returns 0 or -1. */
+static int source_open(InterfaceSource *src)
 {
-    if (!iface || !pool)
-        return -1;
-
-    memset(iface, 0, sizeof(*iface));
-    iface->listen_port = listen_port;
-    iface->pool = pool;
-    iface->running = 0;
-    iface->sock_fd = -1;
+    const InterfaceSourceConfig *cfg = &src->cfg;
 
     /* Open UDP socket. */
-    iface->sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (iface->sock_fd < 0)
+    src->sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (src->sock_fd < 0)
     {
         perror("interface_init: socket");
         return -1;
     }
 
-    /* Bind to the listen port on all interfaces. */
+    /* Bind to the source's port, on all interfaces unless a local
+     * address is given. */
     struct sockaddr_in addr;
     memset(&addr, 0, sizeof(addr));
     addr.sin_family = AF_INET;
-    addr.sin_port = htons(listen_port);
+    addr.sin_port = htons(cfg->port);
     addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (cfg->bind_host && inet_pton(AF_INET, cfg->bind_host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "interface_init: %s: invalid bind address '%s'\n",
+                cfg->name, cfg->bind_host);
+        return -1;
+    }
+
+    if (bind(src->sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "interface_init: %s: bind to port %u: %s\n",
+                cfg->name, (unsigned)cfg->port, strerror(errno));
+        return -1;
+    }
+
+    /* Non-blocking: the thread only reads after poll() reports data, and
+     * must never stall on one source. */
+    int flags = fcntl(src->sock_fd, F_GETFL, 0);
+    if (flags < 0 || fcntl(src->sock_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+    {
+        perror("interface_init: fcntl");
+        return -1;
+    }
+
+    /* Ask for kernel receive timestamps.  Not fatal: without them the
+     * receive thread stamps datagrams itself. */
+    if (rx_timestamp_enable(src->sock_fd) < 0)
+        perror("interface_init: receive timestamps");
+
+    return 0;
+}
+
+int interface_init(CommandInterface *iface,
+                   const InterfaceSourceConfig *sources, size_t count,
+                   CommandPool *pool, DbLogRing *log)
+{
+    if (!iface || !sources || !pool)
+        return -1;
+
+    memset(iface, 0, sizeof(*iface));
+    iface->pool = pool;
+    iface->log = log;
+    iface->running = 0;
+    iface->wake_pipe[0] = iface->wake_pipe[1] = -1;
+    iface->thread_sched.priority = 0;
+    iface->thread_sched.cpu = -1;
+    for (size_t i = 0; i < INTERFACE_MAX_SOURCES; ++i)
+        iface->sources[i].sock_fd = -1;
+
+    if (count == 0 || count > INTERFACE_MAX_SOURCES || count > POOL_MAX_SOURCES)
+    {
+        fprintf(stderr, "interface_init: %zu sources configured (1..%u supported)\n",
+                count, (unsigned)INTERFACE_MAX_SOURCES);
+        return -1;
+    }
 
-    if (bind(iface->sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    if (pipe(iface->wake_pipe) < 0)
     {
-        perror("interface_init: bind");
-        close(iface->sock_fd);
-        iface->sock_fd = -1;
+        perror("interface_init: pipe");
         return -1;
     }
 
+    for (size_t i = 0; i < count; ++i)
+    {
+        iface->sources[i].cfg = sources[i];
+        lat_hist_init(&iface->sources[i].transit);
+        if (sources[i].rate_limit_hz != 0)
+        {
+            uint32_t burst = sources[i].rate_burst ? sources[i].rate_burst : 1u;
+            iface->sources[i].rate_interval_ns = 1000000000ull / sources[i].rate_limit_hz;
+            iface->sources[i].rate_tolerance_ns =
+                (uint64_t)(burst - 1u) * iface->sources[i].rate_interval_ns;
+        }
+        iface->source_count = i + 1;
+        if (source_open(&iface->sources[i]) != 0)
+        {
+            interface_destroy(iface);
+            return -1;
+        }
+    }
+
     return 0;
 }
 
+void interface_set_capture(CommandInterface *iface, CaptureRing *ring, uint8_t first_id)
+{
+    if (!iface)
+        return;
+    iface->capture = ring;
+    iface->capture_base = first_id;
+}
+
+void interface_set_thread(CommandInterface *iface, const RtThreadSched *sched)
+{
+    if (iface && sched)
+        iface->thread_sched = *sched;
+}
+
 int interface_start(CommandInterface *iface)
 {
-    if (!iface || iface->sock_fd < 0)
+    if (!iface || iface->source_count == 0)
         return -1;
 
     iface->running = 1;
 
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-
-    /* On QNX use SCHED_FIFO; the interface thread runs at a moderate
-     * real-time priority so it never blocks the MCU logic thread. */
-#ifdef __QNXNTO__
-    struct sched_param sp;
-    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-    sp.sched_priority = 20; /* tune as required */
-    pthread_attr_setschedparam(&attr, &sp);
-    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-#endif
-
-    int rc = pthread_create(&iface->thread, &attr, interface_thread, iface);
-    pthread_attr_destroy(&attr);
+    /* SCHED_FIFO at a moderate real-time priority, below the MCU logic
+     * thread so it never blocks it (see rt_thread.c), unless
+     * interface_set_thread() chose otherwise. */
+    int rc = rt_thread_create_sched(&iface->thread, RT_THREAD_INTERFACE, &iface->thread_sched,
+                                    interface_thread, iface);
 
     if (rc != 0)
     {
@@ -190,9 +574,13 @@ void interface_stop(CommandInterface *iface)
 
     iface->running = 0;
 
-    /* Unblock the recv() call so the thread can exit cleanly. */
-    if (iface->sock_fd >= 0)
-        shutdown(iface->sock_fd, SHUT_RDWR);
+    /* Unblock the poll() call so the thread can exit cleanly. */
+    if (iface->wake_pipe[1] >= 0)
+    {
+        const char byte = 0;
+        if (write(iface->wake_pipe[1], &byte, 1) < 0)
+            perror("interface_stop: write");
+    }
 
     pthread_join(iface->thread, NULL);
 }
@@ -202,9 +590,64 @@ void interface_destroy(CommandInterface *iface)
     if (!iface)
         return;
 
-    if (iface->sock_fd >= 0)
+    for (size_t i = 0; i < iface->source_count; ++i)
     {
-        close(iface->sock_fd);
-        iface->sock_fd = -1;
+        if (iface->sources[i].sock_fd >= 0)
+        {
+            close(iface->sources[i].sock_fd);
+            iface->sources[i].sock_fd = -1;
+        }
+    }
+    iface->source_count = 0;
+
+    for (int i = 0; i < 2; ++i)
+    {
+        if (iface->wake_pipe[i] >= 0)
+        {
+            close(iface->wake_pipe[i]);
+            iface->wake_pipe[i] = -1;
+        }
+    }
+}
+
+int interface_get_source_stats(CommandInterface *iface, size_t index,
+                               InterfaceSourceStats *out)
+{
+    if (!iface || !out || index >= iface->source_count)
+        return -1;
+
+    const InterfaceSourceStats *s = &iface->sources[index].stats;
+    out->received = stat_read(&s->received);
+    out->malformed = stat_read(&s->malformed);
+    out->throttled = stat_read(&s->throttled);
+    out->clamped = stat_read(&s->clamped);
+    out->pushed = stat_read(&s->pushed);
+    out->dropped = stat_read(&s->dropped);
+    out->legacy = stat_read(&s->legacy);
+    out->gaps = stat_read(&s->gaps);
+    out->reordered = stat_read(&s->reordered);
+    out->duplicates = stat_read(&s->duplicates);
+    out->seq_resets = stat_read(&s->seq_resets);
+    out->errors = stat_read(&s->errors);
+    return 0;
+}
+
+void interface_dump_transit(CommandInterface *iface, FILE *out)
+{
+    if (!iface || !out)
+        return;
+
+    fprintf(out, "Sender-to-receive transit by source:\n");
+    for (size_t i = 0; i < iface->source_count; ++i)
+    {
+        LatencyHist snap;
+        lat_hist_snapshot(&iface->sources[i].transit, &snap);
+        if (snap.count == 0)
+            continue;
+
+        char label[32];
+        snprintf(label, sizeof(label), "  %-8s", iface->sources[i].cfg.name);
+        lat_hist_print(out, label, &snap);
     }
+    fflush(out);
 }
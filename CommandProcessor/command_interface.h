@@ -2,37 +2,144 @@
 #define COMMAND_INTERFACE_H
 
 #include <stdint.h>
+#include <stdio.h>
+#include <netinet/in.h>
+#include "capture.h"
 #include "command_pool.h"
-
-#include "dbstruct.h"
-#include <mqueue.h>
-#include <fcntl.h>
+#include "db_logger.h"
+#include "latency_hist.h"
+#include "rt_thread.h"
 
 /* -----------------------------------------------------------------------
  * CommandInterface
  *
- * Owns a UDP socket that listens for inbound Ackermann packets from the
- * navigation team.  For each valid packet it:
- *   1. Records the receive timestamp.
- *   2. Parses the trailing freshness_ms and priority fields.
- *   3. Computes  valid_until = recv_time + freshness_ms.
- *   4. Pushes a PoolEntry (opaque ackermann bytes + metadata) into the
+ * Owns one UDP socket per configured command source (nav planner, teleop
+ * station, safety supervisor, ...), each bound to its own port and
+ * optionally its own local address.  For each valid packet it:
+ *   1. Records the receive timestamp and drops the datagram if its source
+ *      is over its rate limit (see below).
+ *   2. Parses the trailing freshness_ms and priority fields and, for
+ *      version 2 packets, drops the command if its sequence number is
+ *      not newer than the last one accepted from the same source
+ *      (duplicate or reordered delivery).
+ *   3. Clamps the priority to the source's priority ceiling, so a source
+ *      can never outrank the sources configured above it.
+ *   4. Computes  valid_until = recv_time + freshness_ms (a freshness of
+ *      0, or a legacy packet without the field, never expires).
+ *   5. Tags the entry with its source id — the source's index in the
+ *      configuration table — used by the pool's coalescing mode.
+ *   6. Pushes a PoolEntry (opaque ackermann bytes + metadata) into the
  *      shared CommandPool.
+ *   7. Queues a database record on its DbLogRing (never blocks).
+ *
+ * With a Capture attached, every datagram received — valid or not — is
+ * also queued for the capture file with its receive timestamp.
+ *
+ * All sockets are served by a single POSIX thread blocked in poll(), so
+ * adding a source does not add a thread.  On every wake-up each readable
+ * source is given one recvmmsg batch of at most INTERFACE_BATCH_MAX
+ * datagrams, in rotating order, so a flooding source cannot starve the
+ * others; whatever it has left is picked up on the next pass.
  *
- * The interface runs in its own POSIX thread.
+ * The thread is started through rt_thread as the interface role:
+ * SCHED_FIFO at priority 20 unless interface_set_thread() overrides it.
+ * The policy is always applied on QNX, and on Linux in hardened mode
+ * (--rt); if that fails with EPERM the thread runs under the default
+ * policy and a warning is printed.  In hardened mode the thread is also
+ * pinned to the CPU from its RtThreadSched or RtConfig, if one is set.
+ *
+ * A source with a rate limit is policed by a token bucket of rate_limit_hz
+ * tokens per second and depth rate_burst, checked against the kernel
+ * receive stamp before the command is parsed or reaches the pool.  A
+ * flooding sender is cut back to its configured rate, so it cannot fill
+ * the pool and push out other sources' commands.  The bucket is kept in
+ * its virtual-scheduling (GCRA) form: one timestamp per source, and a
+ * compare and an add per conforming datagram.
  * ----------------------------------------------------------------------- */
 
+/* Most datagrams taken per recvmmsg call and pushed per pool batch; also
+ * the per-source receive budget of one poll pass. */
+#define INTERFACE_BATCH_MAX 16u
+
+/* Most sources one interface can serve.  Must not exceed POOL_MAX_SOURCES. */
+#define INTERFACE_MAX_SOURCES 8u
+
+/* One entry of the source table handed to interface_init(). */
+typedef struct {
+    const char     *name;               /* label used in logs and stats     */
+    uint16_t        port;               /* UDP port to bind                 */
+    const char     *bind_host;          /* local IPv4 address, NULL = any   */
+    uint8_t         priority_ceiling;   /* higher priorities are clamped    */
+    uint8_t         wfq_weight;         /* share under POOL_SCHED_WFQ, 0 = 1 */
+    uint32_t        rate_limit_hz;      /* sustained commands/s, 0 = unlimited */
+    uint32_t        rate_burst;         /* commands accepted back to back, 0 = 1 */
+} InterfaceSourceConfig;
+
+/* Per-source counters; read a snapshot with interface_get_source_stats(). */
+typedef struct {
+    uint64_t        received;           /* datagrams read from the socket   */
+    uint64_t        malformed;          /* dropped: unexpected size         */
+    uint64_t        throttled;          /* dropped: over the rate limit     */
+    uint64_t        clamped;            /* priority lowered to the ceiling  */
+    uint64_t        pushed;             /* accepted by the pool             */
+    uint64_t        dropped;            /* rejected: pool ingress ring full */
+    uint64_t        legacy;             /* accepted without a sequence number */
+    uint64_t        gaps;               /* sequence numbers never received  */
+    uint64_t        reordered;          /* dropped: older than last accepted */
+    uint64_t        duplicates;         /* dropped: same seq as last accepted */
+    uint64_t        seq_resets;         /* sequence restarted by the sender */
+    uint64_t        errors;             /* failed recv or poll calls        */
+} InterfaceSourceStats;
+
 typedef struct {
-    int             sock_fd;        /* UDP socket file descriptor           */
-    uint16_t        listen_port;    /* port we bind to                      */
-    CommandPool    *pool;           /* shared pool — NOT owned by interface */
+    InterfaceSourceConfig cfg;
+    int             sock_fd;            /* UDP socket file descriptor       */
+    InterfaceSourceStats stats;         /* written by the receive thread    */
+
+    /* Rate limiter — receive thread only. */
+    uint64_t        rate_interval_ns;   /* one token, 0 = unlimited         */
+    uint64_t        rate_tolerance_ns;  /* burst headroom: (burst - 1) tokens */
+    uint64_t        rate_tat_ns;        /* when the bucket is full again    */
+
+    /* Sequence tracking — receive thread only. */
+    int             have_seq;           /* last_seq is valid                */
+    uint32_t        last_seq;           /* newest sequence number accepted  */
+    uint64_t        last_sender_ts_ns;  /* its sender timestamp             */
+
+    /* Sender timestamp to kernel receive time, version 2 packets only.
+     * Meaningful when both clocks are synchronised (PTP/NTP). */
+    LatencyHist     transit;
+} InterfaceSource;
+
+typedef struct {
+    InterfaceSource sources[INTERFACE_MAX_SOURCES];
+    size_t          source_count;
+    int             wake_pipe[2];       /* written by interface_stop()      */
+    CommandPool    *pool;               /* shared pool — NOT owned by interface */
+    DbLogRing      *log;                /* receive log ring, NULL = none    */
+    CaptureRing    *capture;            /* traffic capture, NULL = none     */
+    uint8_t         capture_base;       /* capture id of sources[0]         */
+    RtThreadSched   thread_sched;       /* receive thread priority and CPU  */
     pthread_t       thread;
-    volatile int    running;        /* set to 0 to request shutdown         */
+    volatile int    running;            /* set to 0 to request shutdown     */
 } CommandInterface;
 
-/* Initialise the interface (opens socket, does NOT start the thread). */
-int  interface_init(CommandInterface *iface, uint16_t listen_port,
-                    CommandPool *pool);
+/* Initialise the interface: opens and binds one socket per entry of
+ * sources[0..count) (does NOT start the thread).  The table is copied;
+ * the name and bind_host strings must outlive the interface.  Received
+ * commands are logged to log (may be NULL). */
+int  interface_init(CommandInterface *iface,
+                    const InterfaceSourceConfig *sources, size_t count,
+                    CommandPool *pool, DbLogRing *log);
+
+/* Record every received datagram to ring (NULL stops recording), with
+ * source i recorded as capture source first_id + i.  Call before
+ * interface_start(). */
+void interface_set_capture(CommandInterface *iface, CaptureRing *ring, uint8_t first_id);
+
+/* Override the receive thread's priority and CPU (see RtThreadSched).
+ * Call before interface_start(). */
+void interface_set_thread(CommandInterface *iface, const RtThreadSched *sched);
 
 /* Start the receive thread. */
 int  interface_start(CommandInterface *iface);
@@ -43,7 +150,13 @@ void interface_stop(CommandInterface *iface);
 /* Release all resources. */
 void interface_destroy(CommandInterface *iface);
 
-//Message queue struct
-extern mqd_t mqd;
+/* Copy the counters of source index into *out.  Safe from any thread.
+ * Returns 0, or -1 if index is out of range. */
+int  interface_get_source_stats(CommandInterface *iface, size_t index,
+                                InterfaceSourceStats *out);
+
+/* Print the sender-to-receive transit histogram of every source that has
+ * sent version 2 packets.  Safe to call while the thread runs. */
+void interface_dump_transit(CommandInterface *iface, FILE *out);
 
 #endif /* COMMAND_INTERFACE_H */
@@ -1,3 +1,4 @@
+#define _GNU_SOURCE /* sem_clockwait on glibc */
 #include "command_pool.h"
 
 #include <string.h>
@@ -5,15 +6,683 @@
 #include <stdio.h>
 
 /* -----------------------------------------------------------------------
- * Internal helpers
+ * Counter helpers
+ *
+ * Consumer-side counters have a single writer, so a relaxed load/store
+ * pair is enough for readers on other threads to see whole values.
+ * Producer-side counters are shared and use an atomic add.
  * ----------------------------------------------------------------------- */
 
-/* Returns 1 if entry a should be ranked higher than entry b.
- * Primary key: priority (higher wins).
- * Tie-break:   valid_until (longer remaining life wins). */
-static inline int entry_beats(const PoolEntry *a, const PoolEntry *b)
+static inline void stat_add(uint64_t *counter, uint64_t n)
 {
-    return a->priority > b->priority;
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_read(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* Publish the queue depth after it changed.  Consumer thread only. */
+static inline void depth_update(CommandPool *pool)
+{
+    __atomic_store_n(&pool->stats.depth, (uint64_t)pool->count, __ATOMIC_RELAXED);
+    if (pool->count > pool->stats.depth_hwm)
+        __atomic_store_n(&pool->stats.depth_hwm, (uint64_t)pool->count, __ATOMIC_RELAXED);
+}
+
+/* -----------------------------------------------------------------------
+ * Slot free list
+ *
+ * Treiber stack shared by the producers (which pop slots to fill) and
+ * the consumer (which pushes slots back once their entry has been popped,
+ * expired or dropped).  free_top packs the index of the first free slot
+ * with a tag bumped on every update, so a CAS cannot succeed on a stale
+ * top that was popped and pushed back in between (ABA).
+ * ----------------------------------------------------------------------- */
+
+#define FREE_INDEX(top) ((uint16_t)((top) & 0xFFFFu))
+#define FREE_TOP(top, idx) ((((top) + 0x100000000ull) & ~0xFFFFFFFFull) | (uint64_t)(idx))
+
+#if POOL_SLOT_COUNT >= POOL_INDEX_NONE
+#error "POOL_SLOT_COUNT must stay below POOL_INDEX_NONE"
+#endif
+
+/* Take one free slot, or POOL_INDEX_NONE if none is left. */
+static uint16_t free_pop(CommandPool *pool)
+{
+    uint64_t top = __atomic_load_n(&pool->free_top, __ATOMIC_ACQUIRE);
+
+    for (;;)
+    {
+        uint16_t idx = FREE_INDEX(top);
+        if (idx == POOL_INDEX_NONE)
+            return POOL_INDEX_NONE;
+
+        /* free_next may be stale if another thread took idx meanwhile;
+         * the tag then makes the CAS fail. */
+        uint16_t next = __atomic_load_n(&pool->slots[idx].free_next, __ATOMIC_RELAXED);
+        if (__atomic_compare_exchange_n(&pool->free_top, &top, FREE_TOP(top, next),
+                                        1, __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+            return idx;
+    }
+}
+
+/* Return a slot to the free list.  Any thread. */
+static void free_push(CommandPool *pool, uint16_t idx)
+{
+    uint64_t top = __atomic_load_n(&pool->free_top, __ATOMIC_RELAXED);
+
+    do
+    {
+        __atomic_store_n(&pool->slots[idx].free_next, FREE_INDEX(top), __ATOMIC_RELAXED);
+    } while (!__atomic_compare_exchange_n(&pool->free_top, &top, FREE_TOP(top, idx),
+                                          1, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
+
+/* -----------------------------------------------------------------------
+ * Priority structure helpers
+ *
+ * Only ever touched by the consumer thread.
+ * ----------------------------------------------------------------------- */
+
+static inline void bitmap_set(CommandPool *pool, uint8_t prio)
+{
+    pool->bitmap[prio >> 6] |= (uint64_t)1 << (prio & 63u);
+}
+
+static inline void bitmap_clear(CommandPool *pool, uint8_t prio)
+{
+    pool->bitmap[prio >> 6] &= ~((uint64_t)1 << (prio & 63u));
+}
+
+/* Returns the lowest non-empty priority, or -1 if every bucket is empty. */
+static inline int bitmap_lowest(const CommandPool *pool)
+{
+    for (int w = 0; w < (int)POOL_BITMAP_WORDS; ++w)
+    {
+        uint64_t bits = pool->bitmap[w];
+        if (bits != 0)
+            return w * 64 + __builtin_ctzll(bits);
+    }
+    return -1;
+}
+
+/* Returns the highest non-empty priority, or -1 if every bucket is empty.
+ * Scans a fixed POOL_BITMAP_WORDS words, so the cost is constant. */
+static inline int bitmap_highest(const CommandPool *pool)
+{
+    for (int w = (int)POOL_BITMAP_WORDS - 1; w >= 0; --w)
+    {
+        uint64_t bits = pool->bitmap[w];
+        if (bits != 0)
+            return w * 64 + (63 - __builtin_clzll(bits));
+    }
+    return -1;
+}
+
+/* Append a slot to the tail of its priority bucket. */
+static void bucket_append(CommandPool *pool, uint16_t idx)
+{
+    uint8_t prio = pool->slots[idx].entry.priority;
+    PoolBucket *b = &pool->buckets[prio];
+
+    pool->slots[idx].next = POOL_INDEX_NONE;
+    pool->slots[idx].prev = b->tail;
+    if (b->tail == POOL_INDEX_NONE)
+    {
+        b->head = idx;
+        bitmap_set(pool, prio);
+    }
+    else
+    {
+        pool->slots[b->tail].next = idx;
+    }
+    b->tail = idx;
+}
+
+/* Detach a slot from anywhere in its priority bucket — O(1). */
+static void bucket_unlink(CommandPool *pool, uint16_t idx)
+{
+    PoolSlot *slot = &pool->slots[idx];
+    uint8_t prio = slot->entry.priority;
+    PoolBucket *b = &pool->buckets[prio];
+
+    if (slot->prev == POOL_INDEX_NONE)
+        b->head = slot->next;
+    else
+        pool->slots[slot->prev].next = slot->next;
+
+    if (slot->next == POOL_INDEX_NONE)
+        b->tail = slot->prev;
+    else
+        pool->slots[slot->next].prev = slot->prev;
+
+    if (b->head == POOL_INDEX_NONE)
+        bitmap_clear(pool, prio);
+}
+
+/* Put slot repl in the bucket position of slot idx (same priority). */
+static void bucket_replace(CommandPool *pool, uint16_t idx, uint16_t repl)
+{
+    PoolSlot *old = &pool->slots[idx];
+    PoolBucket *b = &pool->buckets[old->entry.priority];
+
+    pool->slots[repl].next = old->next;
+    pool->slots[repl].prev = old->prev;
+
+    if (old->prev == POOL_INDEX_NONE)
+        b->head = repl;
+    else
+        pool->slots[old->prev].next = repl;
+
+    if (old->next == POOL_INDEX_NONE)
+        b->tail = repl;
+    else
+        pool->slots[old->next].prev = repl;
+}
+
+/* Append a slot to the tail (newest end) of the pool-wide age list. */
+static void age_append(CommandPool *pool, uint16_t idx)
+{
+    pool->slots[idx].age_next = POOL_INDEX_NONE;
+    pool->slots[idx].age_prev = pool->age_tail;
+    if (pool->age_tail == POOL_INDEX_NONE)
+        pool->age_head = idx;
+    else
+        pool->slots[pool->age_tail].age_next = idx;
+    pool->age_tail = idx;
+}
+
+/* Detach a slot from anywhere in the age list — O(1). */
+static void age_unlink(CommandPool *pool, uint16_t idx)
+{
+    PoolSlot *slot = &pool->slots[idx];
+
+    if (slot->age_prev == POOL_INDEX_NONE)
+        pool->age_head = slot->age_next;
+    else
+        pool->slots[slot->age_prev].age_next = slot->age_next;
+
+    if (slot->age_next == POOL_INDEX_NONE)
+        pool->age_tail = slot->age_prev;
+    else
+        pool->slots[slot->age_next].age_prev = slot->age_prev;
+}
+
+/* -----------------------------------------------------------------------
+ * Scheduling heap
+ *
+ * Binary min-heap of slot indices ordered by sched_key, used by the EDF
+ * and WFQ policies.  Each slot records its heap position so a queued
+ * entry can be removed from anywhere when it is evicted or coalesced.
+ * Equal keys go to the higher priority, then to the older entry.
+ * ----------------------------------------------------------------------- */
+
+static inline int sched_policy_uses_heap(const CommandPool *pool)
+{
+    return pool->sched == POOL_SCHED_EDF || pool->sched == POOL_SCHED_WFQ;
+}
+
+/* Returns 1 if slot a should be popped before slot b. */
+static inline int heap_before(const CommandPool *pool, uint16_t a, uint16_t b)
+{
+    const PoolSlot *sa = &pool->slots[a];
+    const PoolSlot *sb = &pool->slots[b];
+
+    if (sa->sched_key != sb->sched_key)
+        return sa->sched_key < sb->sched_key;
+    if (sa->entry.priority != sb->entry.priority)
+        return sa->entry.priority > sb->entry.priority;
+    return sa->entry.recv_ns < sb->entry.recv_ns;
+}
+
+static inline void heap_place(CommandPool *pool, size_t pos, uint16_t idx)
+{
+    pool->heap[pos] = idx;
+    pool->slots[idx].heap_pos = (uint16_t)pos;
+}
+
+static void heap_sift_up(CommandPool *pool, size_t pos)
+{
+    uint16_t idx = pool->heap[pos];
+
+    while (pos > 0)
+    {
+        size_t parent = (pos - 1u) / 2u;
+        if (!heap_before(pool, idx, pool->heap[parent]))
+            break;
+        heap_place(pool, pos, pool->heap[parent]);
+        pos = parent;
+    }
+    heap_place(pool, pos, idx);
+}
+
+static void heap_sift_down(CommandPool *pool, size_t pos)
+{
+    uint16_t idx = pool->heap[pos];
+
+    for (;;)
+    {
+        size_t child = 2u * pos + 1u;
+        if (child >= pool->heap_count)
+            break;
+        if (child + 1u < pool->heap_count &&
+            heap_before(pool, pool->heap[child + 1u], pool->heap[child]))
+            child++;
+        if (!heap_before(pool, pool->heap[child], idx))
+            break;
+        heap_place(pool, pos, pool->heap[child]);
+        pos = child;
+    }
+    heap_place(pool, pos, idx);
+}
+
+static void heap_insert(CommandPool *pool, uint16_t idx)
+{
+    pool->heap[pool->heap_count] = idx;
+    heap_sift_up(pool, pool->heap_count++);
+}
+
+/* Remove a slot from anywhere in the heap — O(log n). */
+static void heap_remove(CommandPool *pool, uint16_t idx)
+{
+    size_t pos = pool->slots[idx].heap_pos;
+    uint16_t last = pool->heap[--pool->heap_count];
+
+    if (last == idx)
+        return;
+    heap_place(pool, pos, last);
+    heap_sift_up(pool, pos);
+    heap_sift_down(pool, pool->slots[last].heap_pos);
+}
+
+/* WFQ flow of an entry: its source, or one shared flow for the rest. */
+static inline size_t wfq_flow(uint8_t source)
+{
+    return source < POOL_MAX_SOURCES ? source : POOL_MAX_SOURCES;
+}
+
+/* Fixed-point unit of WFQ virtual time: one command of weight 1. */
+#define WFQ_COST 65536ull
+
+/* Key a newly queued slot and add it to the heap.  inherit is the slot it
+ * coalesces over, or POOL_INDEX_NONE.  A command that replaces one from
+ * its own flow keeps that command's finish tag, so coalescing does not
+ * push a source further back in the fair-queuing order. */
+static void sched_enqueue(CommandPool *pool, uint16_t idx, uint16_t inherit)
+{
+    if (!sched_policy_uses_heap(pool))
+        return;
+
+    PoolSlot *slot = &pool->slots[idx];
+    if (pool->sched == POOL_SCHED_EDF)
+    {
+        slot->sched_key = (slot->entry.valid_until_ns == POOL_NO_DEADLINE)
+                              ? UINT64_MAX
+                              : slot->entry.valid_until_ns;
+    }
+    else if (inherit != POOL_INDEX_NONE &&
+             wfq_flow(pool->slots[inherit].entry.source) == wfq_flow(slot->entry.source))
+    {
+        slot->sched_key = pool->slots[inherit].sched_key;
+    }
+    else
+    {
+        /* Self-clocked fair queuing: a flow's next command starts where its
+         * previous one finished, or at the current virtual time if the flow
+         * was idle, and costs WFQ_COST / weight. */
+        size_t flow = wfq_flow(slot->entry.source);
+        uint64_t start = pool->wfq_finish[flow] > pool->wfq_vtime ? pool->wfq_finish[flow]
+                                                                   : pool->wfq_vtime;
+        slot->sched_key = start + WFQ_COST / pool->wfq_weight[flow];
+        pool->wfq_finish[flow] = slot->sched_key;
+    }
+    heap_insert(pool, idx);
+}
+
+/* Forget a queued slot's age-list, source-map and heap links. */
+static inline void slot_forget(CommandPool *pool, uint16_t idx)
+{
+    age_unlink(pool, idx);
+    if (sched_policy_uses_heap(pool))
+        heap_remove(pool, idx);
+
+    uint8_t src = pool->slots[idx].entry.source;
+    if (src < POOL_MAX_SOURCES && pool->source_slot[src] == idx)
+        pool->source_slot[src] = POOL_INDEX_NONE;
+}
+
+/* Return a (bucket-unlinked) queued slot to the free list. */
+static inline void slot_release(CommandPool *pool, uint16_t idx)
+{
+    slot_forget(pool, idx);
+    free_push(pool, idx);
+    pool->count--;
+    depth_update(pool);
+}
+
+/* Returns 1 if the entry's deadline has passed at time now_ns. */
+static inline int entry_expired(const PoolEntry *e, uint64_t now_ns)
+{
+    return e->valid_until_ns != POOL_NO_DEADLINE && e->valid_until_ns <= now_ns;
+}
+
+/* Find the pending entry a new one should replace under the current
+ * coalescing mode, or POOL_INDEX_NONE to queue it normally. */
+static uint16_t coalesce_target(const CommandPool *pool, const PoolEntry *entry)
+{
+    switch (pool->coalesce)
+    {
+    case POOL_COALESCE_PRIORITY:
+        /* Latest wins within a priority: at most one entry per bucket. */
+        return pool->buckets[entry->priority].tail;
+    case POOL_COALESCE_SOURCE:
+        if (entry->source < POOL_MAX_SOURCES)
+            return pool->source_slot[entry->source];
+        return POOL_INDEX_NONE;
+    case POOL_COALESCE_NONE:
+    default:
+        return POOL_INDEX_NONE;
+    }
+}
+
+/* Account for a command lost to overload. */
+static inline void count_drop(CommandPool *pool, uint8_t prio)
+{
+    stat_add(&pool->stats.dropped_by_priority[prio], 1);
+}
+
+/* Evict a queued entry to make room for *incoming when POOL_CAPACITY
+ * entries are queued, following pool->overload.  Both eviction choices are O(1): the
+ * lowest non-empty bucket comes from the bitmap and the oldest entry is
+ * the head of the age list.
+ * Returns 0 if a slot was freed, -1 if *incoming must be dropped. */
+static int overload_make_room(CommandPool *pool, const PoolEntry *incoming)
+{
+    uint16_t victim = POOL_INDEX_NONE;
+
+    switch (pool->overload)
+    {
+    case POOL_OVERLOAD_EVICT_LOWEST:
+    {
+        /* Never displace a command that outranks the incoming one; on a
+         * tie the newer command wins. */
+        int lowest = bitmap_lowest(pool);
+        if (lowest >= 0 && lowest <= incoming->priority)
+            victim = pool->buckets[lowest].head;
+        break;
+    }
+    case POOL_OVERLOAD_EVICT_OLDEST:
+        victim = pool->age_head;
+        break;
+    case POOL_OVERLOAD_REJECT:
+    default:
+        break;
+    }
+
+    if (victim == POOL_INDEX_NONE)
+    {
+        stat_add(&pool->stats.dropped_full, 1);
+        count_drop(pool, incoming->priority);
+        return -1;
+    }
+
+    count_drop(pool, pool->slots[victim].entry.priority);
+    stat_add(&pool->stats.evicted, 1);
+    bucket_unlink(pool, victim);
+    slot_release(pool, victim);
+    return 0;
+}
+
+/* Link the filled slot idx into its priority bucket — O(1).  In a
+ * coalescing mode it takes the place of an existing pending entry
+ * instead, so the backlog never holds more than one command per priority
+ * (or per source). */
+static void pool_insert(CommandPool *pool, uint16_t idx)
+{
+    const PoolEntry *entry = &pool->slots[idx].entry;
+    uint16_t old = coalesce_target(pool, entry);
+
+    if (old != POOL_INDEX_NONE)
+    {
+        stat_add(&pool->stats.coalesced, 1);
+
+        if (pool->slots[old].entry.priority == entry->priority)
+        {
+            /* Same bucket: take over its position. */
+            bucket_replace(pool, old, idx);
+        }
+        else
+        {
+            /* Same source, new priority: queue in the new bucket. */
+            bucket_unlink(pool, old);
+            bucket_append(pool, idx);
+        }
+        slot_forget(pool, old);
+        sched_enqueue(pool, idx, old);
+        free_push(pool, old);
+
+        /* The content is new, so it is now the youngest entry. */
+        age_append(pool, idx);
+        if (entry->source < POOL_MAX_SOURCES)
+            pool->source_slot[entry->source] = idx;
+        return;
+    }
+
+    if (pool->count >= POOL_CAPACITY && overload_make_room(pool, entry) != 0)
+    {
+        free_push(pool, idx);
+        return;
+    }
+
+    bucket_append(pool, idx);
+    age_append(pool, idx);
+    sched_enqueue(pool, idx, POOL_INDEX_NONE);
+    pool->count++;
+    depth_update(pool);
+
+    if (entry->source < POOL_MAX_SOURCES)
+        pool->source_slot[entry->source] = idx;
+}
+
+/* Aging: effective priority is the bucket level plus one level per
+ * aging_step_ns the command has waited, capped at the top level.  Only
+ * bucket heads compete, since each is the oldest of its level.  The
+ * oldest queued entry bounds every boost, so the scan from the top stops
+ * at the first level that could not catch up even with that boost.
+ * Equal effective priority goes to the higher level. */
+static uint16_t aging_pick(const CommandPool *pool, uint64_t now_ns)
+{
+    const uint64_t step = pool->aging_step_ns;
+    const uint64_t oldest_ns = pool->slots[pool->age_head].entry.recv_ns;
+    const uint64_t max_boost = now_ns > oldest_ns ? (now_ns - oldest_ns) / step : 0u;
+
+    uint16_t best = POOL_INDEX_NONE;
+    uint64_t best_eff = 0;
+
+    for (int p = bitmap_highest(pool); p >= 0; --p)
+    {
+        if (best != POOL_INDEX_NONE && (uint64_t)p + max_boost <= best_eff)
+            break;
+        if (!(pool->bitmap[p / 64] & (1ull << (p % 64))))
+            continue;
+
+        uint16_t head = pool->buckets[p].head;
+        uint64_t recv_ns = pool->slots[head].entry.recv_ns;
+        uint64_t eff = (uint64_t)p + (now_ns > recv_ns ? (now_ns - recv_ns) / step : 0u);
+        if (eff > POOL_PRIORITY_LEVELS - 1u)
+            eff = POOL_PRIORITY_LEVELS - 1u;
+
+        if (best == POOL_INDEX_NONE || eff > best_eff)
+        {
+            best = head;
+            best_eff = eff;
+        }
+    }
+    return best;
+}
+
+/* The slot the scheduling policy would pop next.  The pool must not be
+ * empty. */
+static uint16_t sched_pick(const CommandPool *pool, uint64_t now_ns)
+{
+    switch (pool->sched)
+    {
+    case POOL_SCHED_EDF:
+    case POOL_SCHED_WFQ:
+        return pool->heap[0];
+    case POOL_SCHED_AGING:
+        return aging_pick(pool, now_ns);
+    case POOL_SCHED_STRICT:
+    default:
+        return pool->buckets[bitmap_highest(pool)].head;
+    }
+}
+
+/* Remove the best live entry into *out.  Stale entries met on the way
+ * are discarded and counted; each entry is examined at most once, so
+ * expiry adds no per-pop cost beyond the entries it drops.
+ * Returns 0 if an entry was taken, 1 if the pool ran empty. */
+static int take_best(CommandPool *pool, uint64_t now_ns, PoolEntry *out)
+{
+    while (pool->count > 0)
+    {
+        uint16_t idx = sched_pick(pool, now_ns);
+        const PoolEntry *e = &pool->slots[idx].entry;
+        bucket_unlink(pool, idx);
+
+        if (entry_expired(e, now_ns))
+        {
+            stat_add(&pool->stats.expired, 1);
+            stat_add(&pool->stats.expired_by_priority[e->priority], 1);
+            slot_release(pool, idx);
+            continue;
+        }
+
+        /* Virtual time follows the finish tag of the command in service. */
+        if (pool->sched == POOL_SCHED_WFQ)
+            pool->wfq_vtime = pool->slots[idx].sched_key;
+
+        *out = *e;
+        slot_release(pool, idx);
+        stat_add(&pool->stats.popped, 1);
+        return 0;
+    }
+    return 1;
+}
+
+/* Take up to max live entries, best first.  One clock read serves the
+ * whole batch. */
+static size_t take_batch(CommandPool *pool, PoolEntry *out, size_t max)
+{
+    uint64_t now_ns = monotonic_now_ns();
+    size_t n = 0;
+
+    while (n < max && take_best(pool, now_ns, &out[n]) == 0)
+        n++;
+    return n;
+}
+
+/* -----------------------------------------------------------------------
+ * Ingress ring
+ *
+ * Bounded MPSC queue of slot indices with a per-cell sequence number
+ * (Vyukov).  A producer claims a position with a CAS on enqueue_pos,
+ * stores the index of a filled slot into the cell and publishes it by
+ * storing seq = pos + 1.  The consumer
+ * reads cells in order and hands each back by storing
+ * seq = pos + POOL_INGRESS_CAPACITY.
+ * ----------------------------------------------------------------------- */
+
+#define INGRESS_MASK (POOL_INGRESS_CAPACITY - 1u)
+
+#if (POOL_INGRESS_CAPACITY & INGRESS_MASK) != 0
+#error "POOL_INGRESS_CAPACITY must be a power of two"
+#endif
+
+#if POOL_INGRESS_CAPACITY < 2u * POOL_PRIORITY_LEVELS
+#error "POOL_INGRESS_CAPACITY must leave the lowest priority half the ring"
+#endif
+
+/* Link every published slot from the ring into the priority buckets.
+ * Consumer only. */
+static void ingress_drain(CommandPool *pool)
+{
+    for (;;)
+    {
+        uint32_t pos = pool->dequeue_pos;
+        IngressCell *cell = &pool->ring[pos & INGRESS_MASK];
+
+        if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) != pos + 1u)
+            break; /* next position not yet published */
+
+        pool_insert(pool, cell->slot);
+        __atomic_store_n(&cell->seq, pos + POOL_INGRESS_CAPACITY, __ATOMIC_RELEASE);
+        pool->dequeue_pos = pos + 1u;
+    }
+}
+
+/* Wait on a semaphore until abs_timeout on CLOCK_MONOTONIC, or forever
+ * when abs_timeout is NULL.  Returns 0 when posted, 1 on timeout. */
+static int sem_wait_monotonic(sem_t *sem, const struct timespec *abs_timeout)
+{
+    for (;;)
+    {
+        int rc;
+        if (!abs_timeout)
+            rc = sem_wait(sem);
+        else
+#if defined(__QNXNTO__)
+            rc = sem_timedwait_monotonic(sem, abs_timeout);
+#elif defined(__GLIBC__) && (__GLIBC__ > 2 || (__GLIBC__ == 2 && __GLIBC_MINOR__ >= 30))
+            rc = sem_clockwait(sem, CLOCK_MONOTONIC, abs_timeout);
+#else
+        {
+            /* Translate the monotonic deadline onto the realtime clock. */
+            struct timespec mono, real, abs_real;
+            clock_gettime(CLOCK_MONOTONIC, &mono);
+            clock_gettime(CLOCK_REALTIME, &real);
+            int64_t delta = (int64_t)timespec_to_ns(abs_timeout) - (int64_t)timespec_to_ns(&mono);
+            uint64_t target = timespec_to_ns(&real) + (delta > 0 ? (uint64_t)delta : 0u);
+            abs_real.tv_sec = (time_t)(target / 1000000000ull);
+            abs_real.tv_nsec = (long)(target % 1000000000ull);
+            rc = sem_timedwait(sem, &abs_real);
+        }
+#endif
+        if (rc == 0)
+            return 0;
+        if (errno == ETIMEDOUT)
+            return 1;
+        if (errno != EINTR)
+        {
+            perror("pool: sem_wait");
+            return 1;
+        }
+    }
+}
+
+/* Sleep until a producer publishes, pool_wake() is called or
+ * abs_timeout passes.  Returns 0 when woken, 1 on timeout. */
+static int consumer_wait(CommandPool *pool, const struct timespec *abs_timeout)
+{
+    /* Announce that we are about to sleep, then re-check the ring.  The
+     * fences pair with the one in ingress_notify so that either we see the
+     * producer's entry or the producer sees consumer_idle == 1. */
+    __atomic_store_n(&pool->consumer_idle, 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    const IngressCell *cell = &pool->ring[pool->dequeue_pos & INGRESS_MASK];
+    if (__atomic_load_n(&cell->seq, __ATOMIC_ACQUIRE) == pool->dequeue_pos + 1u ||
+        __atomic_load_n(&pool->wake_requested, __ATOMIC_RELAXED))
+    {
+        __atomic_store_n(&pool->consumer_idle, 0u, __ATOMIC_RELAXED);
+        return 0;
+    }
+
+    int rc = sem_wait_monotonic(&pool->wake, abs_timeout);
+    __atomic_store_n(&pool->consumer_idle, 0u, __ATOMIC_RELAXED);
+    return rc;
 }
 
 /* -----------------------------------------------------------------------
@@ -25,28 +694,39 @@ int pool_init(CommandPool *pool)
     if (!pool)
         return -1;
 
-    memset(pool->entries, 0, sizeof(pool->entries));
-    pool->count = 0;
+    memset(pool, 0, sizeof(*pool));
+
+    /* Each ring cell starts free for the position it will first hold. */
+    for (uint32_t i = 0; i < POOL_INGRESS_CAPACITY; ++i)
+        pool->ring[i].seq = i;
 
-    if (pthread_mutex_init(&pool->lock, NULL) != 0)
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
     {
-        perror("pool_init: pthread_mutex_init");
-        return -1;
+        pool->buckets[p].head = POOL_INDEX_NONE;
+        pool->buckets[p].tail = POOL_INDEX_NONE;
     }
+    for (size_t src = 0; src < POOL_MAX_SOURCES; ++src)
+        pool->source_slot[src] = POOL_INDEX_NONE;
+    pool->age_head = POOL_INDEX_NONE;
+    pool->age_tail = POOL_INDEX_NONE;
+    pool->coalesce = POOL_COALESCE_NONE;
+    pool->overload = POOL_OVERLOAD_REJECT;
+    pool->sched = POOL_SCHED_STRICT;
+    pool->aging_step_ns = POOL_AGING_STEP_DEFAULT_NS;
+    for (size_t flow = 0; flow <= POOL_MAX_SOURCES; ++flow)
+        pool->wfq_weight[flow] = 1u;
 
-    pthread_condattr_t cattr;
-    pthread_condattr_init(&cattr);
-    // Use CLOCK_MONOTONIC so timed waits are not affected by wall-clock
-    pthread_condattr_setclock(&cattr, CLOCK_MONOTONIC);
+    /* Thread every slot onto the free list. */
+    for (size_t i = 0; i < POOL_SLOT_COUNT; ++i)
+        pool->slots[i].free_next = (i + 1 < POOL_SLOT_COUNT) ? (uint16_t)(i + 1) : POOL_INDEX_NONE;
+    pool->free_top = 0; /* tag 0, first free slot 0 */
+    pool->count = 0;
 
-    if (pthread_cond_init(&pool->not_empty, &cattr) != 0)
+    if (sem_init(&pool->wake, 0, 0) != 0)
     {
-        perror("pool_init: pthread_cond_init");
-        pthread_mutex_destroy(&pool->lock);
-        pthread_condattr_destroy(&cattr);
+        perror("pool_init: sem_init");
         return -1;
     }
-    pthread_condattr_destroy(&cattr);
 
     return 0;
 }
@@ -55,75 +735,354 @@ void pool_destroy(CommandPool *pool)
 {
     if (!pool)
         return;
-    pthread_cond_destroy(&pool->not_empty);
-    pthread_mutex_destroy(&pool->lock);
+    sem_destroy(&pool->wake);
+}
+
+/* Ring cells a command of priority prio must leave free.  Under
+ * EVICT_LOWEST each level may take one cell fewer than the level above,
+ * so no flood can take the last cell from a more urgent command; the
+ * other policies do not rank by priority and use the whole ring. */
+static inline uint32_t ingress_headroom(const CommandPool *pool, uint8_t prio)
+{
+    if (pool->overload != POOL_OVERLOAD_EVICT_LOWEST)
+        return 0u;
+    return (POOL_PRIORITY_LEVELS - 1u) - prio;
 }
 
-/* Push — O(n) insertion that keeps the array sorted (descending by rank)
- * so that the best entry is always at index 0.  For POOL_CAPACITY = 64
- * this is perfectly adequate; switch to a proper heap if capacity grows. */
+/* Claim n consecutive ring positions for this producer, leaving headroom
+ * more cells free behind them (headroom + n <= POOL_INGRESS_CAPACITY).
+ * Because the consumer frees cells strictly in order, the run and its
+ * headroom are free as soon as the last headroom cell is.  Returns 0 and
+ * the first position in *pos_out, or -1 if the ring does not have room. */
+static int ingress_claim(CommandPool *pool, uint32_t n, uint32_t headroom, uint32_t *pos_out)
+{
+    uint32_t pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+
+    for (;;)
+    {
+        uint32_t last = pos + n - 1u + headroom;
+        uint32_t seq = __atomic_load_n(&pool->ring[last & INGRESS_MASK].seq,
+                                       __ATOMIC_ACQUIRE);
+        int32_t diff = (int32_t)(seq - last);
+
+        if (diff == 0)
+        {
+            /* Run is free for this lap — try to claim it. */
+            if (__atomic_compare_exchange_n(&pool->enqueue_pos, &pos, pos + n,
+                                            1, __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+            {
+                *pos_out = pos;
+                return 0;
+            }
+            /* pos was reloaded by the failed CAS; retry. */
+        }
+        else if (diff < 0)
+        {
+            /* Consumer has not released the cells yet: not enough room. */
+            return -1;
+        }
+        else
+        {
+            /* Another producer claimed part of the run; catch up. */
+            pos = __atomic_load_n(&pool->enqueue_pos, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/* Store a filled slot into a claimed cell and hand it to the consumer.
+ * The release store also publishes the slot's entry. */
+static inline void ingress_publish(CommandPool *pool, uint32_t pos, uint16_t slot)
+{
+    IngressCell *cell = &pool->ring[pos & INGRESS_MASK];
+    cell->slot = slot;
+    __atomic_store_n(&cell->seq, pos + 1u, __ATOMIC_RELEASE);
+}
+
+/* Wake the consumer only if it is (about to be) asleep. */
+static inline void ingress_notify(CommandPool *pool)
+{
+    /* Pairs with the fence in consumer_wait(). */
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&pool->consumer_idle, __ATOMIC_RELAXED) &&
+        __atomic_exchange_n(&pool->consumer_idle, 0u, __ATOMIC_RELAXED))
+        sem_post(&pool->wake);
+}
+
+/* Push — lock-free: take a slot, copy the entry in and publish it.
+ * Never blocks; fails only if the consumer has fallen a whole ring
+ * behind. */
 int pool_push(CommandPool *pool, const PoolEntry *entry)
 {
     if (!pool || !entry)
         return -1;
 
-    pthread_mutex_lock(&pool->lock);
+    return (pool_push_batch(pool, entry, 1) == 1) ? 0 : -1;
+}
+
+size_t pool_push_batch(CommandPool *pool, const PoolEntry *entries, size_t n)
+{
+    if (!pool || !entries || n == 0)
+        return 0;
+
+    uint16_t slots[32];
+    size_t pushed = 0, offered = 0;
 
-    if (pool->count >= POOL_CAPACITY)
+    /* In chunks, so the caller's batch size is not limited by slots[]. */
+    while (offered < n)
     {
-        pthread_mutex_unlock(&pool->lock);
-        fprintf(stderr, "pool_push: pool full, dropping command\n");
-        return -1;
+        size_t want = n - offered;
+        if (want > sizeof(slots) / sizeof(slots[0]))
+            want = sizeof(slots) / sizeof(slots[0]);
+
+        size_t got = pool_reserve(pool, slots, want);
+        for (size_t i = 0; i < got; ++i)
+            pool->slots[slots[i]].entry = entries[offered + i];
+
+        size_t done = pool_commit(pool, slots, got); /* counts ring-full drops */
+        pushed += done;
+        offered += got;
+        if (got < want || done < got)
+            break;
     }
 
-    /* Find insertion point so array stays sorted best→worst. */
-    size_t insert_at = pool->count;
-    for (size_t i = 0; i < pool->count; ++i)
+    /* Entries that never got a slot. */
+    if (offered < n)
+        __atomic_fetch_add(&pool->ingress_full, n - offered, __ATOMIC_RELAXED);
+    return pushed;
+}
+
+size_t pool_reserve(CommandPool *pool, uint16_t *slots, size_t n)
+{
+    if (!pool || !slots)
+        return 0;
+
+    size_t got = 0;
+    while (got < n)
     {
-        if (entry_beats(entry, &pool->entries[i]))
-        {
-            insert_at = i;
+        uint16_t idx = free_pop(pool);
+        if (idx == POOL_INDEX_NONE)
             break;
-        }
+        slots[got++] = idx;
     }
+    return got;
+}
+
+void pool_cancel(CommandPool *pool, const uint16_t *slots, size_t n)
+{
+    if (!pool || !slots)
+        return;
 
-    /* Shift entries down to make room. */
-    for (size_t i = pool->count; i > insert_at; --i)
-        pool->entries[i] = pool->entries[i - 1];
+    for (size_t i = 0; i < n; ++i)
+        free_push(pool, slots[i]);
+}
 
-    pool->entries[insert_at] = *entry;
-    pool->count++;
+size_t pool_commit(CommandPool *pool, const uint16_t *slots, size_t n)
+{
+    if (!pool || !slots || n == 0)
+        return 0;
 
-    pthread_cond_signal(&pool->not_empty);
-    pthread_mutex_unlock(&pool->lock);
+    size_t pushed = 0;
+    uint32_t pos;
 
-    return 0;
+    /* The whole run must leave the headroom of its least urgent entry. */
+    uint32_t headroom = 0;
+    for (size_t i = 0; i < n; ++i)
+    {
+        uint32_t h = ingress_headroom(pool, pool->slots[slots[i]].entry.priority);
+        if (h > headroom)
+            headroom = h;
+    }
+
+    if (n + headroom <= POOL_INGRESS_CAPACITY &&
+        ingress_claim(pool, (uint32_t)n, headroom, &pos) == 0)
+    {
+        /* Fast path: one CAS for the whole batch. */
+        for (size_t i = 0; i < n; ++i)
+            ingress_publish(pool, pos + (uint32_t)i, slots[i]);
+        pushed = n;
+    }
+    else
+    {
+        /* Not enough room for the run — place what fits, in order.  An
+         * entry that does not fit is freed, and later, more urgent
+         * entries of the batch may still get in. */
+        for (size_t i = 0; i < n; ++i)
+        {
+            uint8_t prio = pool->slots[slots[i]].entry.priority;
+            if (ingress_claim(pool, 1, ingress_headroom(pool, prio), &pos) != 0)
+            {
+                free_push(pool, slots[i]);
+                continue;
+            }
+            ingress_publish(pool, pos, slots[i]);
+            pushed++;
+        }
+    }
+
+    if (pushed > 0)
+    {
+        __atomic_fetch_add(&pool->pushed, pushed, __ATOMIC_RELAXED);
+        ingress_notify(pool);
+    }
+    if (pushed < n)
+        __atomic_fetch_add(&pool->ingress_full, n - pushed, __ATOMIC_RELAXED);
+
+    return pushed;
 }
 
 /*
- * Pop the highest-priority entry.
- * Blocks on the condition variable if the pool is empty.
+ * Pop the highest-priority entry — O(1) plus the ring drain.
+ * Sleeps on the wake semaphore while the pool is empty.
  */
 int pool_pop_best(CommandPool *pool, PoolEntry *out)
 {
     if (!pool || !out)
         return -1;
 
-    pthread_mutex_lock(&pool->lock);
+    for (;;)
+    {
+        ingress_drain(pool);
+        if (take_best(pool, monotonic_now_ns(), out) == 0)
+            return 0;
+
+        /* Consume the request, as pool_pop_batch does; left set, it
+         * would make every consumer_wait() return at once. */
+        if (__atomic_exchange_n(&pool->wake_requested, 0u, __ATOMIC_RELAXED))
+            return 1;
+
+        /* Empty, or everything left was stale — wait for fresh commands. */
+        consumer_wait(pool, NULL);
+    }
+}
+
+int pool_pop_best_timed(CommandPool *pool, PoolEntry *out,
+                        const struct timespec *abs_timeout)
+{
+    if (!pool || !out || !abs_timeout)
+        return -1;
+
+    int n = pool_pop_batch(pool, out, 1, abs_timeout);
+    if (n < 0)
+        return -1;
+    return (n == 1) ? 0 : 1;
+}
+
+int pool_pop_batch(CommandPool *pool, PoolEntry *out, size_t max,
+                   const struct timespec *abs_timeout)
+{
+    if (!pool || !out || max == 0)
+        return -1;
 
-    while (pool->count == 0)
+    for (;;)
     {
-        pthread_cond_wait(&pool->not_empty, &pool->lock);
+        /* Expire whatever went stale while we slept and take the best. */
+        ingress_drain(pool);
+        size_t n = take_batch(pool, out, max);
+        if (n > 0)
+            return (int)n;
+
+        if (__atomic_exchange_n(&pool->wake_requested, 0u, __ATOMIC_RELAXED))
+            return 0;
+
+        /* abs_timeout is on CLOCK_MONOTONIC, the same clock used for
+         * valid_until_ns. */
+        if (consumer_wait(pool, abs_timeout) == 1)
+        {
+            /* One last look: entries may have landed with the timeout. */
+            ingress_drain(pool);
+            return (int)take_batch(pool, out, max);
+        }
     }
+}
+
+int pool_try_pop_best(CommandPool *pool, PoolEntry *out)
+{
+    if (!pool || !out)
+        return -1;
 
-    /* Best entry is always at index 0. */
-    *out = pool->entries[0];
+    ingress_drain(pool);
+    return take_best(pool, monotonic_now_ns(), out);
+}
 
-    /* Shift remaining entries up. */
-    for (size_t i = 0; i < pool->count - 1; ++i)
-        pool->entries[i] = pool->entries[i + 1];
-    pool->count--;
+void pool_set_coalesce(CommandPool *pool, PoolCoalesceMode mode)
+{
+    if (!pool)
+        return;
+    pool->coalesce = mode;
+}
 
-    pthread_mutex_unlock(&pool->lock);
+void pool_set_overload_policy(CommandPool *pool, PoolOverloadPolicy policy)
+{
+    if (!pool)
+        return;
+    pool->overload = policy;
+}
+
+void pool_set_sched_policy(CommandPool *pool, PoolSchedPolicy policy)
+{
+    if (!pool)
+        return;
+    pool->sched = policy;
+}
+
+void pool_set_aging_step(CommandPool *pool, uint64_t step_ns)
+{
+    if (!pool)
+        return;
+    pool->aging_step_ns = step_ns ? step_ns : 1u;
+}
+
+int pool_set_source_weight(CommandPool *pool, uint8_t source, uint8_t weight)
+{
+    if (!pool || (source >= POOL_MAX_SOURCES && source != POOL_SOURCE_NONE))
+        return -1;
+    pool->wfq_weight[wfq_flow(source)] = weight ? weight : 1u;
     return 0;
 }
+
+const char *pool_sched_policy_name(PoolSchedPolicy policy)
+{
+    switch (policy)
+    {
+    case POOL_SCHED_STRICT:
+        return "strict";
+    case POOL_SCHED_EDF:
+        return "edf";
+    case POOL_SCHED_AGING:
+        return "aging";
+    case POOL_SCHED_WFQ:
+        return "wfq";
+    default:
+        return "unknown";
+    }
+}
+
+void pool_wake(CommandPool *pool)
+{
+    if (!pool)
+        return;
+
+    __atomic_store_n(&pool->wake_requested, 1u, __ATOMIC_RELAXED);
+    sem_post(&pool->wake);
+}
+
+void pool_get_stats(CommandPool *pool, PoolStats *out)
+{
+    if (!pool || !out)
+        return;
+
+    out->pushed = __atomic_load_n(&pool->pushed, __ATOMIC_RELAXED);
+    out->ingress_full = __atomic_load_n(&pool->ingress_full, __ATOMIC_RELAXED);
+    out->popped = stat_read(&pool->stats.popped);
+    out->dropped_full = stat_read(&pool->stats.dropped_full);
+    out->evicted = stat_read(&pool->stats.evicted);
+    out->expired = stat_read(&pool->stats.expired);
+    out->coalesced = stat_read(&pool->stats.coalesced);
+    out->depth = stat_read(&pool->stats.depth);
+    out->depth_hwm = stat_read(&pool->stats.depth_hwm);
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+    {
+        out->expired_by_priority[p] = stat_read(&pool->stats.expired_by_priority[p]);
+        out->dropped_by_priority[p] = stat_read(&pool->stats.dropped_by_priority[p]);
+    }
+}
@@ -2,24 +2,88 @@
 #define COMMAND_POOL_H
 
 #include <stdint.h>
+#include <stddef.h>
 #include <time.h>
 #include <pthread.h>
+#include <semaphore.h>
 
 /* -----------------------------------------------------------------------
  * Wire format of an inbound UDP packet from the navigation team.
  *
  *   [ ackermann_payload (ACKERMANN_PAYLOAD_SIZE bytes) ]
+ *   [ freshness_ms : uint32_t big-endian (4 bytes)     ]
  *   [ priority     : uint8_t  (1 byte)                 ]
+ *   --- version 2 only ---------------------------------
+ *   [ version      : uint8_t  (1 byte, = 2)            ]
+ *   [ flags        : uint8_t  (1 byte)                 ]
+ *   [ seq          : uint32_t big-endian (4 bytes)     ]
+ *   [ sender_ts_ns : uint64_t big-endian (8 bytes)     ]
  *
  * The ackermann_payload is treated as an opaque blob — we never
  * deserialise it.  Only the trailing metadata fields are inspected
  * by this component.
+ *
+ * seq counts up by one per command from each sender (wrapping); a
+ * command that is not newer than the last one accepted from its source
+ * is dropped as a duplicate or as reordered.  sender_ts_ns is the
+ * sender's CLOCK_REALTIME at send time; a seq that goes backwards with a
+ * newer sender_ts_ns is taken as a sender restart.  Senders should also
+ * set INBOUND_FLAG_SEQ_RESET on their first packet.
+ *
+ * The layouts without the version 2 fields (payload + freshness_ms +
+ * priority) and without freshness_ms (payload + priority) are still
+ * accepted, without sequence checks; the latter never expire.
  * ----------------------------------------------------------------------- */
 #define ACKERMANN_PAYLOAD_SIZE 16u /* adjust to match nav team  */
-#define INBOUND_PACKET_SIZE (ACKERMANN_PAYLOAD_SIZE + 1u)
+#define INBOUND_PACKET_SIZE (ACKERMANN_PAYLOAD_SIZE + 4u + 1u)
+#define INBOUND_V2_PACKET_SIZE (INBOUND_PACKET_SIZE + 1u + 1u + 4u + 8u)
+#define INBOUND_LEGACY_PACKET_SIZE (ACKERMANN_PAYLOAD_SIZE + 1u)
+
+#define INBOUND_VERSION_2 2u
+
+/* flags: the sender restarted its sequence; accept seq as a new start. */
+#define INBOUND_FLAG_SEQ_RESET 0x01u
+
+/* valid_until_ns value meaning "never expires". */
+#define POOL_NO_DEADLINE 0u
+
+/* Maximum number of commands that may sit in the pool simultaneously.
+ * Push and pop cost does not depend on this value, so it can be sized
+ * for the worst burst rather than for lock hold time. */
+#define POOL_CAPACITY 1024u
+
+/* One FIFO bucket per possible value of the uint8 priority field. */
+#define POOL_PRIORITY_LEVELS 256u
+#define POOL_BITMAP_WORDS (POOL_PRIORITY_LEVELS / 64u)
+
+/* Sentinel slot index used to terminate the intrusive lists. */
+#define POOL_INDEX_NONE 0xFFFFu
+
+/* Depth of the lock-free ingress ring between the receive threads and the
+ * consumer.  Must be a power of two.  The consumer drains the whole ring
+ * on every pop, so this only needs to absorb what arrives between two
+ * pops.  Under POOL_OVERLOAD_EVICT_LOWEST a command of priority p must
+ * leave POOL_PRIORITY_LEVELS - 1 - p cells free (see pool_commit), so the
+ * lowest priority gets POOL_INGRESS_CAPACITY - 255 cells. */
+#define POOL_INGRESS_CAPACITY 512u
 
-/* Maximum number of commands that may sit in the pool simultaneously. */
-#define POOL_CAPACITY 64u
+/* Slots a producer may hold reserved (pool_reserve) and not yet committed,
+ * summed over all producers.  Slots in flight — reserved, or committed
+ * and waiting in the ingress ring — come out of this headroom and the
+ * ring's, never out of POOL_CAPACITY. */
+#define POOL_RESERVE_MAX 64u
+
+/* Total slots: POOL_CAPACITY queued plus the in-flight headroom.  Must
+ * stay below POOL_INDEX_NONE. */
+#define POOL_SLOT_COUNT (POOL_CAPACITY + POOL_INGRESS_CAPACITY + POOL_RESERVE_MAX)
+
+/* Source keys are small integers assigned by the interface (one per
+ * sender); entries with POOL_SOURCE_NONE are never coalesced by source. */
+#define POOL_MAX_SOURCES 32u
+#define POOL_SOURCE_NONE 0xFFu
+
+/* Assumed cache-line size, used to keep producer and consumer state apart. */
+#define POOL_CACHE_LINE 64
 
 /* -----------------------------------------------------------------------
  * PoolEntry — the unit that lives inside the pool.
@@ -28,34 +92,287 @@ typedef struct
 {
     uint8_t ackermann_bytes[ACKERMANN_PAYLOAD_SIZE]; /* opaque blob       */
     uint8_t priority;                                /* higher = more urgent */
+    uint8_t source;          /* sender key, or POOL_SOURCE_NONE       */
+    uint64_t recv_ns;        /* CLOCK_MONOTONIC receive time          */
+    uint64_t valid_until_ns; /* recv_ns + freshness, or POOL_NO_DEADLINE */
 } PoolEntry;
 
+/* A pool slot: the stored entry plus its links to the neighbouring slots
+ * in the same bucket and in the pool-wide age list.  An unused slot is
+ * chained through free_next on the shared free list.  Slots never move;
+ * an entry is written once, by the producer that reserved the slot. */
+typedef struct
+{
+    PoolEntry entry;
+    uint16_t next;
+    uint16_t prev;
+    uint16_t age_next;  /* towards newer entries             */
+    uint16_t age_prev;  /* towards older entries             */
+    uint16_t free_next; /* free-list link (accessed atomically) */
+    uint16_t heap_pos;  /* index in the scheduling heap (EDF, WFQ) */
+    uint64_t sched_key; /* deadline (EDF) or finish tag (WFQ)    */
+} PoolSlot;
+
+/* FIFO of slot indices holding entries of one priority. */
+typedef struct
+{
+    uint16_t head; /* oldest entry — popped first */
+    uint16_t tail; /* newest entry                */
+} PoolBucket;
+
+/* Counters maintained by the pool; read a snapshot with pool_get_stats(). */
+typedef struct
+{
+    uint64_t pushed;       /* entries accepted by pool_push            */
+    uint64_t popped;       /* entries handed to the consumer           */
+    uint64_t ingress_full; /* pushes rejected: ring full or no free slot */
+    uint64_t dropped_full; /* incoming entries rejected, pool full      */
+    uint64_t evicted;      /* queued entries evicted to make room       */
+    uint64_t expired;      /* entries discarded past their deadline     */
+    uint64_t coalesced;    /* pending entries replaced by a newer one   */
+    uint64_t depth;        /* entries queued now                        */
+    uint64_t depth_hwm;    /* most entries ever queued at once          */
+    uint64_t expired_by_priority[POOL_PRIORITY_LEVELS];
+    /* Commands lost to overload (rejected or evicted), by priority.
+     * Ingress-ring overflow is counted only in ingress_full. */
+    uint64_t dropped_by_priority[POOL_PRIORITY_LEVELS];
+} PoolStats;
+
+/* Optional latest-wins behaviour.  With coalescing on, a new command
+ * overwrites the pending one it matches instead of queueing behind it, so
+ * backlog depth and worst-case command age stay bounded under bursts. */
+typedef enum
+{
+    POOL_COALESCE_NONE,     /* queue every command (default)             */
+    POOL_COALESCE_PRIORITY, /* replace the pending command of equal priority */
+    POOL_COALESCE_SOURCE    /* replace the pending command from the same source */
+} PoolCoalesceMode;
+
+/* What to do with a new command when POOL_CAPACITY commands are queued. */
+typedef enum
+{
+    POOL_OVERLOAD_REJECT,       /* drop the incoming command (default)      */
+    POOL_OVERLOAD_EVICT_LOWEST, /* evict the oldest entry of the lowest
+                                 * priority, unless it outranks the new one */
+    POOL_OVERLOAD_EVICT_OLDEST  /* evict the oldest entry of any priority   */
+} PoolOverloadPolicy;
+
+/* Which queued command a pop returns.  Expiry, coalescing and overload
+ * handling are the same under every policy. */
+typedef enum
+{
+    POOL_SCHED_STRICT, /* highest priority first, FIFO within a level (default) */
+    POOL_SCHED_EDF,    /* earliest valid_until_ns first; commands without a
+                        * deadline after all others, by priority           */
+    POOL_SCHED_AGING,  /* priority raised one level per aging step waited   */
+    POOL_SCHED_WFQ     /* weighted fair queuing across sources, FIFO within
+                        * a source; POOL_SOURCE_NONE shares one flow       */
+} PoolSchedPolicy;
+
+#define POOL_SCHED_POLICY_COUNT 4u
+
+/* Default aging step for POOL_SCHED_AGING, in nanoseconds. */
+#define POOL_AGING_STEP_DEFAULT_NS 10000000ull
+
+/* One cell of the ingress ring: the index of a filled slot.  seq encodes
+ * the cell state for the current lap: seq == pos means free for position
+ * pos, seq == pos + 1 means published and ready for the consumer. */
+typedef struct
+{
+    uint32_t seq;
+    uint16_t slot;
+} IngressCell;
+
 /* -----------------------------------------------------------------------
- * CommandPool — thread-safe, priority-ordered pool.
+ * CommandPool — lock-free ingress, priority-ordered pool.
+ *
+ * Producers (the receive threads) take a free slot from a lock-free
+ * free list, fill its entry in place (the receive path points recv
+ * straight at it, see pool_reserve) and publish the slot index into a
+ * bounded multi-producer / single-consumer ring using a CAS on the
+ * enqueue position; they never block and never take a lock.  The single
+ * consumer (the MCU thread) drains the ring into its private priority
+ * structure at the start of every pop, so no lock is shared across the
+ * two real-time priorities.  An entry is never copied between receive
+ * and pop; only 16-bit slot indices move.  Overload handling in the
+ * buckets only sees what got through the ring, so under
+ * POOL_OVERLOAD_EVICT_LOWEST the ring admits by priority too (see
+ * pool_commit).
+ *
+ * The private structure is one FIFO bucket per priority level plus a
+ * bitmap of the non-empty buckets.  The best entry is the head of the
+ * bucket found by a find-last-set over the bitmap, so insertion and pop
+ * are O(1) regardless of POOL_CAPACITY.  Entries of equal priority leave
+ * in arrival order.  Slots are linked by index; entries are never shifted.
  *
- * Internally a max-heap ordered by (priority DESC, valid_until DESC).
- * All public functions are safe to call from multiple threads.
+ * Expiry is lazy: a bucket head whose valid_until_ns has passed is
+ * discarded when a pop reaches it, so a stale command is never returned
+ * and live entries pay nothing for the check.
+ *
+ * The buckets always hold every queued entry; the scheduling policy only
+ * chooses which one a pop takes.  Strict priority is the bitmap lookup
+ * above.  Aging compares the heads of the non-empty buckets, stopping as
+ * soon as no lower level can catch up.  EDF and WFQ keep a binary
+ * min-heap of slot indices on sched_key alongside the buckets, so their
+ * push and pop are O(log n).
+ *
+ * pool_push may be called from any number of threads.  The pop functions
+ * must only be called from one consumer thread.
  * ----------------------------------------------------------------------- */
 typedef struct
 {
-    PoolEntry entries[POOL_CAPACITY];
-    size_t count;
-    pthread_mutex_t lock;
-    pthread_cond_t not_empty; /* signalled whenever an entry is pushed  */
+    /* --- Shared with producers --------------------------------------- */
+    IngressCell ring[POOL_INGRESS_CAPACITY];
+    PoolSlot slots[POOL_SLOT_COUNT]; /* entries written by producers    */
+    uint64_t free_top __attribute__((aligned(POOL_CACHE_LINE)));
+    /* free_top: ABA tag << 32 | index of the first free slot          */
+    uint32_t enqueue_pos __attribute__((aligned(POOL_CACHE_LINE)));
+    uint32_t consumer_idle;  /* 1 while the consumer sleeps on wake      */
+    uint32_t wake_requested; /* set by pool_wake()                       */
+    uint64_t pushed;        /* producer-side counters (atomic)           */
+    uint64_t ingress_full;
+    sem_t wake;             /* posted when the idle consumer must wake   */
+
+    /* --- Consumer-private -------------------------------------------- */
+    uint32_t dequeue_pos __attribute__((aligned(POOL_CACHE_LINE)));
+    PoolBucket buckets[POOL_PRIORITY_LEVELS];
+    uint64_t bitmap[POOL_BITMAP_WORDS]; /* bit p set => bucket p non-empty */
+    uint16_t source_slot[POOL_MAX_SOURCES]; /* pending slot per source    */
+    uint16_t age_head;                      /* oldest queued entry        */
+    uint16_t age_tail;                      /* newest queued entry        */
+    size_t count;                           /* queued entries (<= POOL_CAPACITY) */
+    PoolCoalesceMode coalesce;
+    PoolOverloadPolicy overload;
+    PoolSchedPolicy sched;
+    uint64_t aging_step_ns;                 /* POOL_SCHED_AGING            */
+    uint16_t heap[POOL_CAPACITY];           /* EDF / WFQ min-heap of slots */
+    size_t heap_count;
+    uint64_t wfq_vtime;                     /* finish tag of the last pop  */
+    uint64_t wfq_finish[POOL_MAX_SOURCES + 1u]; /* last tag per source;
+                                                 * last = POOL_SOURCE_NONE */
+    uint32_t wfq_weight[POOL_MAX_SOURCES + 1u];
+    PoolStats stats; /* consumer-side counters, written atomically */
 } CommandPool;
 
 /* Initialise / destroy -------------------------------------------------- */
 int pool_init(CommandPool *pool);
 void pool_destroy(CommandPool *pool);
 
-/* Push a new entry.  Returns 0 on success, -1 if pool is full. */
+/* Publish a new entry without blocking.  Safe from any thread.
+ * Returns 0 on success, -1 if the ingress ring is full. */
 int pool_push(CommandPool *pool, const PoolEntry *entry);
 
+/* Publish entries[0..n) in order with a single ring reservation when
+ * there is room for all of them.  Safe from any thread.
+ * Returns the number accepted; the rest were dropped because the ingress
+ * ring was full (see pool_commit). */
+size_t pool_push_batch(CommandPool *pool, const PoolEntry *entries, size_t n);
+
 /*
- * Pop the highest-priority entry.
- * Blocks until at least one entry is available.
- * Returns 0 and fills *out on success.
+ * Zero-copy ingress.  Safe from any thread.
+ *
+ * pool_reserve takes up to n free slots and writes their indices to
+ * slots[]; it returns how many it got (fewer when the in-flight headroom
+ * is used up).  The caller fills each entry in place through
+ * pool_slot_entry() — typically by pointing recv at its ackermann_bytes —
+ * then either publishes the slots with pool_commit or hands unused ones
+ * back with pool_cancel.  A reserved slot must end up in exactly one of
+ * the two.
+ *
+ * pool_commit publishes slots[0..n) in order and returns the number
+ * accepted; the rest were dropped because the ingress ring was full, and
+ * their slots are freed.  Under POOL_OVERLOAD_EVICT_LOWEST admission is
+ * by priority: a command of priority p is only placed while the ring
+ * keeps POOL_PRIORITY_LEVELS - 1 - p cells free, so a flood can fill the
+ * ring against lower priorities but never against a higher one, and the
+ * dropped commands need not be a tail of the batch.
+ */
+size_t pool_reserve(CommandPool *pool, uint16_t *slots, size_t n);
+size_t pool_commit(CommandPool *pool, const uint16_t *slots, size_t n);
+void pool_cancel(CommandPool *pool, const uint16_t *slots, size_t n);
+
+static inline PoolEntry *pool_slot_entry(CommandPool *pool, uint16_t slot)
+{
+    return &pool->slots[slot].entry;
+}
+
+/*
+ * Pop the best entry under the scheduling policy.  Consumer thread only.
+ * Blocks until at least one entry is available or pool_wake() is called.
+ * Returns 0 and fills *out on success, 1 on pool_wake(), -1 on error.
  */
 int pool_pop_best(CommandPool *pool, PoolEntry *out);
 
+/*
+ * As pool_pop_best, but gives up at abs_timeout (CLOCK_MONOTONIC).
+ * Returns 0 and fills *out on success, 1 on timeout or pool_wake(),
+ * -1 on error.
+ */
+int pool_pop_best_timed(CommandPool *pool, PoolEntry *out,
+                        const struct timespec *abs_timeout);
+
+/*
+ * Pop up to max entries, best first, in one pass over the pool.
+ * Consumer thread only.  Waits for the first entry until abs_timeout
+ * (CLOCK_MONOTONIC), or indefinitely when abs_timeout is NULL; never
+ * waits for the batch to fill.
+ * Returns the number of entries written to out[] (0 on timeout or
+ * pool_wake()), or -1 on error.
+ */
+int pool_pop_batch(CommandPool *pool, PoolEntry *out, size_t max,
+                   const struct timespec *abs_timeout);
+
+/*
+ * Non-blocking pop.  Consumer thread only.
+ * Returns 0 and fills *out on success, 1 if no live entry is queued.
+ */
+int pool_try_pop_best(CommandPool *pool, PoolEntry *out);
+
+/* Select the coalescing mode.  Call before any thread uses the pool. */
+void pool_set_coalesce(CommandPool *pool, PoolCoalesceMode mode);
+
+/* Select the overload policy.  Call before any thread uses the pool. */
+void pool_set_overload_policy(CommandPool *pool, PoolOverloadPolicy policy);
+
+/* Select the scheduling policy.  Call before any thread uses the pool. */
+void pool_set_sched_policy(CommandPool *pool, PoolSchedPolicy policy);
+
+/* Set how long a command must wait to gain one priority level under
+ * POOL_SCHED_AGING (0 is taken as 1 ns).  Call before any thread uses
+ * the pool. */
+void pool_set_aging_step(CommandPool *pool, uint64_t step_ns);
+
+/* Set a source's share under POOL_SCHED_WFQ: backlogged sources are
+ * served in proportion to their weights.  Every source starts at 1; a
+ * weight of 0 is taken as 1.  POOL_SOURCE_NONE is accepted and sets the
+ * weight of the shared flow.  Returns 0, or -1 for an unknown source.
+ * Call before any thread uses the pool. */
+int pool_set_source_weight(CommandPool *pool, uint8_t source, uint8_t weight);
+
+/* Short lower-case policy name ("strict", "edf", "aging", "wfq"). */
+const char *pool_sched_policy_name(PoolSchedPolicy policy);
+
+/* Wake a consumer blocked in a pop (used on shutdown).  Safe from any
+ * thread. */
+void pool_wake(CommandPool *pool);
+
+/* Copy the current counters into *out.  Safe from any thread; counters
+ * are read individually, not as one atomic snapshot. */
+void pool_get_stats(CommandPool *pool, PoolStats *out);
+
+/* -----------------------------------------------------------------------
+ * Time helpers
+ * ----------------------------------------------------------------------- */
+static inline uint64_t timespec_to_ns(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+static inline uint64_t monotonic_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return timespec_to_ns(&ts);
+}
+
 #endif /* COMMAND_POOL_H */
@@ -1,10 +1,46 @@
 # listen.py
+#
+# Usage: python listen.py [--ack] [--ack-delay-ms N] [--ack-drop N]
+#
+#   --ack            Expect the ack tag (MCU_ACK_TIMEOUT_MS != 0): each
+#                    datagram is the payload plus a 4-byte id, which is
+#                    echoed back to the sender as the ack.
+#   --ack-delay-ms N Wait N ms before acking, to simulate apply time.
+#   --ack-drop N     Skip every Nth ack, to exercise the missing count.
+import argparse
 import socket
+import struct
+import time
+
+PAYLOAD_SIZE = 16
+ACK_TAG_SIZE = 4
+
+parser = argparse.ArgumentParser()
+parser.add_argument("--ack", action="store_true")
+parser.add_argument("--ack-delay-ms", type=float, default=0.0)
+parser.add_argument("--ack-drop", type=int, default=0)
+args = parser.parse_args()
 
 sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
 sock.bind(("0.0.0.0", 5001))
-print("Listening for forwarded Ackermann packets on :5001...")
+print("Listening for forwarded Ackermann packets on :5001..."
+      + (" (acking)" if args.ack else ""))
 
+count = 0
 while True:
     data, addr = sock.recvfrom(1024)
-    print(f"Received {len(data)} bytes from {addr}: {data.hex()}")
\ No newline at end of file
+    if not args.ack or len(data) != PAYLOAD_SIZE + ACK_TAG_SIZE:
+        print(f"Received {len(data)} bytes from {addr}: {data.hex()}")
+        continue
+
+    payload, tag = data[:PAYLOAD_SIZE], data[PAYLOAD_SIZE:]
+    (ack_id,) = struct.unpack(">I", tag)
+    count += 1
+    if args.ack_drop and count % args.ack_drop == 0:
+        print(f"Received id {ack_id} from {addr}: {payload.hex()} (ack dropped)")
+        continue
+
+    if args.ack_delay_ms:
+        time.sleep(args.ack_delay_ms / 1000.0)
+    sock.sendto(tag, addr)
+    print(f"Received id {ack_id} from {addr}: {payload.hex()} (acked)")
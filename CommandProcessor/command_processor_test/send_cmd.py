@@ -3,25 +3,46 @@ import socket
 import struct
 import time
 
-# Wire format:
+# Wire format (version 2):
 #   16 bytes  ackermann payload (opaque)
 #    4 bytes  freshness_ms (uint32 big-endian)
 #    1 byte   priority (uint8)
+#    1 byte   version (2)
+#    1 byte   flags (bit 0 = sequence reset)
+#    4 bytes  seq (uint32 big-endian)
+#    8 bytes  sender_ts_ns (uint64 big-endian, CLOCK_REALTIME)
 
 VM_IP        = "192.168.56.104"  # change to your VM's actual IP
-VM_PORT      = 5000
-PACKET_SIZE  = 17
+VM_PORT      = 5000               # nav planner source
+SAFETY_PORT  = 5003               # safety supervisor source
+PACKET_SIZE  = 35
+FLAG_SEQ_RESET = 0x01
 
-def send_command(ackermann_bytes, priority):
+# Next sequence number per destination port; the first packet to each
+# port carries the reset flag so reruns of this script are accepted.
+next_seq = {}
+
+def send_command(ackermann_bytes, priority, freshness_ms=1000, port=VM_PORT):
+    sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+    flags = 0 if port in next_seq else FLAG_SEQ_RESET
+    seq = next_seq.get(port, 0)
+    next_seq[port] = seq + 1
+    payload = ackermann_bytes + struct.pack(">IBBBIQ", freshness_ms, priority, 2, flags,
+                                            seq & 0xFFFFFFFF, time.time_ns())
+    sock.sendto(payload, (VM_IP, port))
+    sock.close()
+    print(f"Sent port={port} seq={seq} priority={priority} freshness={freshness_ms}ms data={ackermann_bytes.hex()}")
+    return payload
+
+def resend(payload, port=VM_PORT):
     sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
-    payload = ackermann_bytes + struct.pack(">B", priority)
-    sock.sendto(payload, (VM_IP, VM_PORT))
+    sock.sendto(payload, (VM_IP, port))
     sock.close()
-    print(f"Sent priority={priority} data={ackermann_bytes.hex()}")
+    print(f"Resent port={port} seq={struct.unpack_from('>I', payload, 23)[0]} (duplicate)")
 
 # --- Test 1: single command, generous freshness ---
 ackermann_1 = bytes([0x01] * 16)
-send_command(ackermann_1, priority=5)
+send_command(ackermann_1, priority=5, freshness_ms=5000)
 time.sleep(0.5)
 
 # --- Test 2: two commands back to back, higher priority should win ---
@@ -33,4 +54,16 @@ time.sleep(0.5)
 
 # --- Test 3: expired command (1ms freshness, sleep before it arrives) ---
 ackermann_stale = bytes([0x04] * 16)
-send_command(ackermann_stale, priority=10)
\ No newline at end of file
+send_command(ackermann_stale, priority=10, freshness_ms=1)
+time.sleep(0.5)
+
+# --- Test 4: safety supervisor source (nav commands are capped at 191) ---
+ackermann_safety = bytes([0x05] * 16)
+send_command(ackermann_safety, priority=255, port=SAFETY_PORT)
+time.sleep(0.5)
+
+# --- Test 5: duplicated datagram — forwarded once, then dropped ---
+ackermann_dup = bytes([0x06] * 16)
+dup = send_command(ackermann_dup, priority=5)
+time.sleep(0.1)
+resend(dup)
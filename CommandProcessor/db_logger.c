@@ -0,0 +1,396 @@
+#include "db_logger.h"
+#include "dbstruct.h"
+#include "rt_thread.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+/* Counters have a single writer each; see the matching helpers in
+ * command_pool.c. */
+static inline void stat_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_read(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* -----------------------------------------------------------------------
+ * Producer side
+ * ----------------------------------------------------------------------- */
+
+int dblog_write(DbLogRing *ring, const DbLogRecord *rec)
+{
+    if (!ring)
+        return 0;
+
+    uint32_t head = ring->head; /* only this thread writes head */
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail >= DBLOG_RING_CAPACITY)
+    {
+        stat_add(&ring->overflow, 1);
+        return -1;
+    }
+
+    ring->records[head & (DBLOG_RING_CAPACITY - 1u)] = *rec;
+    __atomic_store_n(&ring->head, head + 1u, __ATOMIC_RELEASE);
+    return 0;
+}
+
+/* -----------------------------------------------------------------------
+ * Row formatting
+ * ----------------------------------------------------------------------- */
+
+/* Send one row to the "logs" table as module "cmd". */
+static void send_row(DbLogger *log, const char *text)
+{
+    DB_t msg;
+    memset(&msg, 0, sizeof(msg));
+    strncpy(msg.table, "logs", sizeof(msg.table)); // "sensors", "states", or "logs"
+    strncpy(msg.id, "cmd", sizeof(msg.id));
+    strncpy(msg.msg, text, sizeof(msg.msg) - 1u);
+
+    if (log->mqd == (mqd_t)-1 || mq_send(log->mqd, (char *)&msg, sizeof(DB_t), 0) == -1)
+    {
+        stat_add(&log->send_failed, 1);
+        return;
+    }
+    stat_add(&log->sent, 1);
+    printf("Sent to DB: table=%s id=%s msg=%s\n", msg.table, msg.id, msg.msg);
+}
+
+/* Format one record and send it to the database. */
+static void log_record(DbLogger *log, const DbLogRecord *rec)
+{
+    long sec = (long)(rec->time_ns / 1000000000ull);
+    long nsec = (long)(rec->time_ns % 1000000000ull);
+    char text[sizeof(((DB_t *)0)->msg)];
+
+    if (rec->kind == DBLOG_RECEIVED)
+    {
+        snprintf(text, sizeof(text),
+                 "Command Received: Source: %s Priority: %u Freshness: %u ms Time: %ld.%09ld",
+                 rec->source ? rec->source : "-", rec->priority, rec->freshness_ms,
+                 sec, nsec);
+    }
+    else if (rec->kind == DBLOG_WATCHDOG)
+    {
+        snprintf(text, sizeof(text),
+                 "Watchdog Stop Sent: Silence: %u ms Priority: %u Time: %ld.%09ld",
+                 rec->freshness_ms, rec->priority, sec, nsec);
+    }
+    else
+    {
+        snprintf(text, sizeof(text), "Command Forwarded: Priority: %u Time: %ld.%09ld",
+                 rec->priority, sec, nsec);
+    }
+    send_row(log, text);
+}
+
+/* -----------------------------------------------------------------------
+ * Interval summaries
+ * ----------------------------------------------------------------------- */
+
+static uint64_t ring_overflow(DbLogger *log)
+{
+    uint64_t total = 0;
+    for (size_t r = 0; r < log->ring_count; ++r)
+        total += stat_read(&log->rings[r].overflow);
+    return total;
+}
+
+/* Start a new interval at now_ns from the current totals. */
+static void summary_reset(DbLogger *log, uint64_t now_ns)
+{
+    DbLogSummary *sum = &log->summary;
+
+    memset(sum->received, 0, sizeof(sum->received));
+    memset(sum->forwarded, 0, sizeof(sum->forwarded));
+    sum->latency_count = 0;
+    sum->latency_sum_ns = 0;
+    sum->latency_min_ns = UINT32_MAX;
+    sum->latency_max_ns = 0;
+    sum->watchdog = 0;
+    sum->start_ns = now_ns;
+    memset(&sum->base, 0, sizeof(sum->base));
+    if (log->counters)
+        log->counters(log->counters_ctx, &sum->base);
+    sum->overflow_base = ring_overflow(log);
+}
+
+/* Count one record into the current interval; log it on its own if it is
+ * a watchdog stop or falls on the sampling rate. */
+static void summary_account(DbLogger *log, const DbLogRecord *rec)
+{
+    DbLogSummary *sum = &log->summary;
+
+    switch (rec->kind)
+    {
+    case DBLOG_RECEIVED:
+        sum->received[rec->priority]++;
+        break;
+    case DBLOG_FORWARDED:
+        sum->forwarded[rec->priority]++;
+        sum->latency_count++;
+        sum->latency_sum_ns += rec->latency_ns;
+        if (rec->latency_ns < sum->latency_min_ns)
+            sum->latency_min_ns = rec->latency_ns;
+        if (rec->latency_ns > sum->latency_max_ns)
+            sum->latency_max_ns = rec->latency_ns;
+        break;
+    case DBLOG_WATCHDOG:
+    default:
+        sum->watchdog++;
+        log_record(log, rec);
+        return;
+    }
+
+    if (log->sample_every != 0 && ++log->sample_count[rec->kind] >= log->sample_every)
+    {
+        log->sample_count[rec->kind] = 0;
+        log_record(log, rec);
+    }
+}
+
+/* Send the rows for the interval ending at now_ns and start the next.
+ * Intervals in which nothing happened send nothing. */
+static void summary_flush(DbLogger *log, uint64_t now_ns)
+{
+    DbLogSummary *sum = &log->summary;
+    DbLogCounters cur;
+    memset(&cur, 0, sizeof(cur));
+    if (log->counters)
+        log->counters(log->counters_ctx, &cur);
+
+    unsigned long long received = 0, forwarded = 0;
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+    {
+        received += sum->received[p];
+        forwarded += sum->forwarded[p];
+    }
+    unsigned long long dropped = cur.dropped - sum->base.dropped;
+    unsigned long long expired = cur.expired - sum->base.expired;
+    unsigned long long throttled = cur.throttled - sum->base.throttled;
+    unsigned long long overflow = ring_overflow(log) - sum->overflow_base;
+
+    if (received || forwarded || sum->watchdog || dropped || expired || throttled || overflow)
+    {
+        char text[sizeof(((DB_t *)0)->msg)];
+
+        snprintf(text, sizeof(text),
+                 "Summary: %llu ms Received: %llu Forwarded: %llu Watchdog: %llu",
+                 (unsigned long long)((now_ns - sum->start_ns) / 1000000ull),
+                 received, forwarded, (unsigned long long)sum->watchdog);
+        send_row(log, text);
+
+        snprintf(text, sizeof(text),
+                 "Summary Losses: Dropped: %llu Expired: %llu Throttled: %llu Unlogged: %llu",
+                 dropped, expired, throttled, overflow);
+        send_row(log, text);
+
+        if (sum->latency_count != 0)
+        {
+            snprintf(text, sizeof(text),
+                     "Summary Latency: Min: %.1f us Avg: %.1f us Max: %.1f us",
+                     (double)sum->latency_min_ns / 1e3,
+                     (double)sum->latency_sum_ns / (double)sum->latency_count / 1e3,
+                     (double)sum->latency_max_ns / 1e3);
+            send_row(log, text);
+        }
+
+        /* Received/forwarded per priority, packed into as few rows as
+         * fit, highest priority first. */
+        static const char prefix[] = "Summary Priority rx/fwd:";
+        size_t len = 0;
+        for (int p = (int)POOL_PRIORITY_LEVELS - 1; p >= 0; --p)
+        {
+            if (sum->received[p] == 0 && sum->forwarded[p] == 0)
+                continue;
+
+            char item[32];
+            int n = snprintf(item, sizeof(item), " %d: %u/%u", p,
+                             (unsigned)sum->received[p], (unsigned)sum->forwarded[p]);
+            if (len != 0 && len + (size_t)n >= sizeof(text))
+            {
+                send_row(log, text);
+                len = 0;
+            }
+            if (len == 0)
+                len = (size_t)snprintf(text, sizeof(text), "%s", prefix);
+            len += (size_t)snprintf(text + len, sizeof(text) - len, "%s", item);
+        }
+        if (len != 0)
+            send_row(log, text);
+
+        fflush(stdout);
+    }
+
+    summary_reset(log, now_ns);
+}
+
+/* -----------------------------------------------------------------------
+ * Logger thread
+ * ----------------------------------------------------------------------- */
+
+/* Drain every ring once.  Returns the number of records handled. */
+static size_t drain_rings(DbLogger *log)
+{
+    size_t handled = 0;
+
+    for (size_t r = 0; r < log->ring_count; ++r)
+    {
+        DbLogRing *ring = &log->rings[r];
+        uint32_t tail = ring->tail; /* only this thread writes tail */
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+        for (; tail != head; ++tail, ++handled)
+        {
+            const DbLogRecord *rec = &ring->records[tail & (DBLOG_RING_CAPACITY - 1u)];
+            if (log->summary_interval_ns != 0)
+                summary_account(log, rec);
+            else
+                log_record(log, rec);
+            /* Free each cell as soon as it is handled so a slow
+             * mq_send does not hold the whole batch. */
+            __atomic_store_n(&ring->tail, tail + 1u, __ATOMIC_RELEASE);
+        }
+    }
+
+    if (handled != 0)
+        fflush(stdout);
+    return handled;
+}
+
+static void *dblog_thread(void *arg)
+{
+    DbLogger *log = (DbLogger *)arg;
+    const struct timespec idle = {0, DBLOG_POLL_INTERVAL_MS * 1000000L};
+
+    rt_thread_enter(RT_THREAD_DBLOG);
+
+    if (log->summary_interval_ns != 0)
+        summary_reset(log, monotonic_now_ns());
+
+    while (log->running)
+    {
+        size_t handled = drain_rings(log);
+
+        if (log->summary_interval_ns != 0)
+        {
+            uint64_t now_ns = monotonic_now_ns();
+            if (now_ns - log->summary.start_ns >= log->summary_interval_ns)
+                summary_flush(log, now_ns);
+        }
+
+        if (handled == 0)
+            nanosleep(&idle, NULL);
+    }
+
+    /* Flush what the producers wrote before they stopped. */
+    drain_rings(log);
+    if (log->summary_interval_ns != 0)
+        summary_flush(log, monotonic_now_ns());
+    return NULL;
+}
+
+/* -----------------------------------------------------------------------
+ * Public API
+ * ----------------------------------------------------------------------- */
+
+int dblog_init(DbLogger *log)
+{
+    if (!log)
+        return -1;
+
+    memset(log, 0, sizeof(*log));
+    log->mqd = (mqd_t)-1;
+    log->running = 0;
+    return 0;
+}
+
+DbLogRing *dblog_register(DbLogger *log)
+{
+    if (!log || log->ring_count >= DBLOG_MAX_RINGS)
+        return NULL;
+
+    return &log->rings[log->ring_count++];
+}
+
+void dblog_set_summary(DbLogger *log, uint32_t interval_ms, uint32_t sample_every,
+                       DbLogCountersFn counters, void *ctx)
+{
+    if (!log)
+        return;
+
+    log->summary_interval_ns = (uint64_t)interval_ms * 1000000ull;
+    log->sample_every = sample_every;
+    log->counters = counters;
+    log->counters_ctx = ctx;
+}
+
+int dblog_start(DbLogger *log)
+{
+    if (!log)
+        return -1;
+
+    // Open message queue to write
+    log->mqd = mq_open("/db_queue", O_WRONLY | O_NONBLOCK);
+    if (log->mqd == (mqd_t)-1)
+    {
+        perror("dblog_start: mq_open");
+        return -1;
+    }
+
+    log->running = 1;
+
+    /* Logging is best effort: run below both real-time threads so
+     * formatting and mq_send never compete with command handling. */
+    int rc = rt_thread_create(&log->thread, RT_THREAD_DBLOG, dblog_thread, log);
+
+    if (rc != 0)
+    {
+        fprintf(stderr, "dblog_start: pthread_create failed: %s\n", strerror(rc));
+        log->running = 0;
+        mq_close(log->mqd);
+        log->mqd = (mqd_t)-1;
+        return -1;
+    }
+
+    return 0;
+}
+
+void dblog_stop(DbLogger *log)
+{
+    if (!log || !log->running)
+        return;
+
+    log->running = 0;
+    pthread_join(log->thread, NULL);
+}
+
+void dblog_destroy(DbLogger *log)
+{
+    if (!log)
+        return;
+
+    if (log->mqd != (mqd_t)-1)
+    {
+        mq_close(log->mqd);
+        log->mqd = (mqd_t)-1;
+    }
+}
+
+void dblog_get_stats(DbLogger *log, DbLogStats *out)
+{
+    if (!log || !out)
+        return;
+
+    out->overflow = ring_overflow(log);
+    out->sent = stat_read(&log->sent);
+    out->send_failed = stat_read(&log->send_failed);
+}
@@ -0,0 +1,157 @@
+#ifndef DB_LOGGER_H
+#define DB_LOGGER_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <pthread.h>
+#include <mqueue.h>
+
+#include "command_pool.h"
+
+/* -----------------------------------------------------------------------
+ * DbLogger — asynchronous database logging.
+ *
+ * The real-time threads never format text, call mq_send or touch stdio
+ * per command.  Each of them owns a DbLogRing, a single-producer /
+ * single-consumer ring of compact fixed-size DbLogRecords, and logs a
+ * command by copying one record into it: a few stores and one release
+ * store of the head index, no syscall and no lock.  When the ring is
+ * full the record is dropped and counted; the producer never waits.
+ *
+ * A low-priority logger thread polls every ring, formats each record into
+ * a DB_t and sends it to /db_queue (echoing it to stdout).  It sleeps for
+ * DBLOG_POLL_INTERVAL_MS whenever all rings are empty, so producers never
+ * have to wake it.
+ *
+ * In summary mode (dblog_set_summary) the logger still reads every
+ * record but, instead of one row per command, sends a few rows per
+ * interval: received and forwarded counts per priority, receive-to-
+ * forward latency min/avg/max, and the drop, expiry and throttle counts
+ * of the interval.  One in every sample_every received and forwarded
+ * records is still logged on its own; watchdog stops always are.  A
+ * record is counted in the interval in which the logger reads it, at
+ * most DBLOG_POLL_INTERVAL_MS after it was written.
+ * ----------------------------------------------------------------------- */
+
+/* Records per ring.  Must be a power of two. */
+#define DBLOG_RING_CAPACITY 1024u
+
+/* Most producer threads (rings) one logger serves. */
+#define DBLOG_MAX_RINGS 8u
+
+/* How long the logger thread sleeps when every ring is empty. */
+#define DBLOG_POLL_INTERVAL_MS 10L
+
+typedef enum
+{
+    DBLOG_RECEIVED,  /* command accepted by the interface */
+    DBLOG_FORWARDED, /* command sent to motor control     */
+    DBLOG_WATCHDOG   /* silence watchdog sent the stop    */
+} DbLogKind;
+
+/* One log record — copied as is, formatted later by the logger thread. */
+typedef struct
+{
+    const char *source;    /* static label (e.g. source name) or NULL   */
+    uint64_t time_ns;      /* CLOCK_MONOTONIC receive or send time      */
+    uint32_t freshness_ms; /* DBLOG_RECEIVED; silence for DBLOG_WATCHDOG */
+    uint32_t latency_ns;   /* DBLOG_FORWARDED: receive to send, saturated */
+    uint8_t kind;          /* DbLogKind                                 */
+    uint8_t priority;
+} DbLogRecord;
+
+/* Running totals the summary reports per interval, supplied by the
+ * application through a DbLogCountersFn.  The logger reports the
+ * difference between two calls. */
+typedef struct
+{
+    uint64_t dropped;   /* commands lost: no slot, ring or pool full, evicted */
+    uint64_t expired;   /* discarded past their deadline               */
+    uint64_t throttled; /* dropped by a source's rate limit            */
+} DbLogCounters;
+
+/* Fill *out with the current totals.  Called on the logger thread, so it
+ * must only read counters that are safe to read from any thread. */
+typedef void (*DbLogCountersFn)(void *ctx, DbLogCounters *out);
+
+/* Interval accumulators — logger thread only. */
+typedef struct
+{
+    uint32_t received[POOL_PRIORITY_LEVELS];
+    uint32_t forwarded[POOL_PRIORITY_LEVELS];
+    uint64_t latency_count;
+    uint64_t latency_sum_ns;
+    uint32_t latency_min_ns;
+    uint32_t latency_max_ns;
+    uint64_t watchdog;
+    uint64_t start_ns;     /* CLOCK_MONOTONIC start of the interval     */
+    DbLogCounters base;    /* counters at the start of the interval     */
+    uint64_t overflow_base;
+} DbLogSummary;
+
+typedef struct
+{
+    DbLogRecord records[DBLOG_RING_CAPACITY];
+    uint32_t head __attribute__((aligned(POOL_CACHE_LINE))); /* producer */
+    uint64_t overflow;                                      /* producer */
+    uint32_t tail __attribute__((aligned(POOL_CACHE_LINE))); /* logger   */
+} DbLogRing;
+
+/* Counters; read a snapshot with dblog_get_stats(). */
+typedef struct
+{
+    uint64_t overflow;    /* records dropped because a ring was full */
+    uint64_t sent;        /* records delivered to /db_queue          */
+    uint64_t send_failed; /* records mq_send could not deliver       */
+} DbLogStats;
+
+typedef struct
+{
+    DbLogRing rings[DBLOG_MAX_RINGS];
+    size_t ring_count;
+    mqd_t mqd;            /* /db_queue, opened by dblog_start()     */
+    uint64_t sent;        /* written by the logger thread           */
+    uint64_t send_failed;
+    uint64_t summary_interval_ns; /* 0 = one row per command        */
+    uint32_t sample_every;        /* summary mode: log 1 in N alone */
+    uint32_t sample_count[DBLOG_WATCHDOG + 1];
+    DbLogCountersFn counters;
+    void *counters_ctx;
+    DbLogSummary summary;
+    pthread_t thread;
+    volatile int running;
+} DbLogger;
+
+/* Initialise an idle logger with no rings. */
+int dblog_init(DbLogger *log);
+
+/* Hand out a ring for one producer thread.  Call before dblog_start().
+ * Returns NULL once DBLOG_MAX_RINGS rings are taken. */
+DbLogRing *dblog_register(DbLogger *log);
+
+/* Switch to summary mode: send aggregated rows every interval_ms instead
+ * of one row per command, plus every sample_every-th received and
+ * forwarded command on its own (0 = none).  counters, if not NULL,
+ * supplies the drop, expiry and throttle totals.  interval_ms 0 restores
+ * per-command logging.  Call before dblog_start(). */
+void dblog_set_summary(DbLogger *log, uint32_t interval_ms, uint32_t sample_every,
+                       DbLogCountersFn counters, void *ctx);
+
+/* Open /db_queue and start the logger thread. */
+int dblog_start(DbLogger *log);
+
+/* Stop the logger thread after it has flushed every ring, and join it. */
+void dblog_stop(DbLogger *log);
+
+/* Release all resources. */
+void dblog_destroy(DbLogger *log);
+
+/* Append one record to ring without blocking.  Owning thread only; a NULL
+ * ring discards the record.  Returns 0, or -1 if the ring was full and
+ * the record was dropped. */
+int dblog_write(DbLogRing *ring, const DbLogRecord *rec);
+
+/* Copy the current counters into *out.  Safe from any thread. */
+void dblog_get_stats(DbLogger *log, DbLogStats *out);
+
+#endif /* DB_LOGGER_H */
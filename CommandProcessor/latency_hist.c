@@ -0,0 +1,100 @@
+#include "latency_hist.h"
+
+#include <string.h>
+
+/* Single-writer counter update / any-thread read; see latency_hist.h. */
+static inline void hist_store(uint64_t *counter, uint64_t value)
+{
+    __atomic_store_n(counter, value, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t hist_load(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+static inline unsigned bucket_of(uint64_t ns)
+{
+    return (ns == 0) ? 0u : 64u - (unsigned)__builtin_clzll(ns);
+}
+
+void lat_hist_init(LatencyHist *h)
+{
+    if (!h)
+        return;
+    memset(h, 0, sizeof(*h));
+    h->min_ns = UINT64_MAX;
+}
+
+void lat_hist_record(LatencyHist *h, uint64_t ns)
+{
+    unsigned b = bucket_of(ns);
+    if (b >= LAT_HIST_BUCKETS)
+        b = LAT_HIST_BUCKETS - 1u;
+
+    hist_store(&h->buckets[b], h->buckets[b] + 1u);
+    hist_store(&h->sum_ns, h->sum_ns + ns);
+    if (ns < h->min_ns)
+        hist_store(&h->min_ns, ns);
+    if (ns > h->max_ns)
+        hist_store(&h->max_ns, ns);
+    hist_store(&h->count, h->count + 1u);
+}
+
+void lat_hist_snapshot(const LatencyHist *h, LatencyHist *out)
+{
+    if (!h || !out)
+        return;
+
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+        out->buckets[b] = hist_load(&h->buckets[b]);
+    out->count = hist_load(&h->count);
+    out->sum_ns = hist_load(&h->sum_ns);
+    out->min_ns = hist_load(&h->min_ns);
+    out->max_ns = hist_load(&h->max_ns);
+}
+
+uint64_t lat_hist_percentile(const LatencyHist *snap, double p)
+{
+    uint64_t total = 0;
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+        total += snap->buckets[b];
+    if (total == 0)
+        return 0;
+
+    uint64_t rank = (uint64_t)(p * (double)total);
+    if (rank >= total)
+        rank = total - 1u;
+
+    uint64_t seen = 0;
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+    {
+        seen += snap->buckets[b];
+        if (seen > rank)
+        {
+            /* Bucket b holds [2^(b-1), 2^b); never report past the max. */
+            uint64_t upper = (b == 0) ? 0u : (b >= 64u ? UINT64_MAX : ((uint64_t)1 << b) - 1u);
+            return (upper < snap->max_ns) ? upper : snap->max_ns;
+        }
+    }
+    return snap->max_ns;
+}
+
+void lat_hist_print(FILE *out, const char *label, const LatencyHist *snap)
+{
+    if (snap->count == 0)
+    {
+        fprintf(out, "%s: n=0\n", label);
+        return;
+    }
+
+    fprintf(out, "%s: n=%llu min=%.1fus avg=%.1fus p50<=%.1fus p99<=%.1fus p99.9<=%.1fus max=%.1fus\n",
+            label,
+            (unsigned long long)snap->count,
+            (double)snap->min_ns / 1e3,
+            (double)snap->sum_ns / (double)snap->count / 1e3,
+            (double)lat_hist_percentile(snap, 0.50) / 1e3,
+            (double)lat_hist_percentile(snap, 0.99) / 1e3,
+            (double)lat_hist_percentile(snap, 0.999) / 1e3,
+            (double)snap->max_ns / 1e3);
+}
@@ -0,0 +1,45 @@
+#ifndef LATENCY_HIST_H
+#define LATENCY_HIST_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+/* -----------------------------------------------------------------------
+ * LatencyHist — fixed-size log2 latency histogram.
+ *
+ * Bucket i counts samples in [2^(i-1), 2^i) nanoseconds (bucket 0 counts
+ * zero), so recording is one count-leading-zeros and a few stores — cheap
+ * enough for the real-time threads.  Each histogram has a single writer;
+ * other threads may read it at any time and see whole (relaxed) values,
+ * not one consistent snapshot.
+ * ----------------------------------------------------------------------- */
+
+#define LAT_HIST_BUCKETS 64u
+
+typedef struct
+{
+    uint64_t buckets[LAT_HIST_BUCKETS];
+    uint64_t count;
+    uint64_t sum_ns;
+    uint64_t min_ns;
+    uint64_t max_ns;
+} LatencyHist;
+
+/* Reset to empty. */
+void lat_hist_init(LatencyHist *h);
+
+/* Record one sample.  Single writer only. */
+void lat_hist_record(LatencyHist *h, uint64_t ns);
+
+/* Copy a histogram from any thread. */
+void lat_hist_snapshot(const LatencyHist *h, LatencyHist *out);
+
+/* Upper bound (ns) of the bucket holding percentile p (0..1) of the
+ * samples in a snapshot, or 0 if it is empty. */
+uint64_t lat_hist_percentile(const LatencyHist *snap, double p);
+
+/* Print "label: n=.. min=.. avg=.. p50<=.. p99<=.. p99.9<=.. max=.." for a
+ * snapshot, in microseconds. */
+void lat_hist_print(FILE *out, const char *label, const LatencyHist *snap);
+
+#endif /* LATENCY_HIST_H */
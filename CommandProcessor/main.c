@@ -5,23 +5,196 @@
 #include <string.h>
 #include <mqueue.h>
 #include <fcntl.h>
+#include <time.h>
 
+#include "capture.h"
+#include "channel.h"
 #include "command_pool.h"
 #include "command_interface.h"
 #include "mcu_logic.h"
+#include "db_logger.h"
 #include "dbstruct.h"
+#include "metrics.h"
+#include "rt_thread.h"
 
 /* -----------------------------------------------------------------------
  * Configuration — adjust these to match your deployment environment.
  * ----------------------------------------------------------------------- */
-#define INTERFACE_LISTEN_PORT   5000u       /* inbound from nav team        */
 #define MCU_TARGET_HOST         "192.168.56.1" /* motor control team UDP host  */
 #define MCU_TARGET_PORT         5001u       /* motor control team UDP port  */
 
+/* Forwarding targets of the drive channel.  Entry 0 is the primary motor
+ * controller; further entries are mirrors that receive a copy of every
+ * forwarded command (and watchdog stop) without ever delaying the
+ * primary.  At most MCU_MAX_TARGETS per channel. */
+static const MCUTargetConfig g_drive_targets[] = {
+    /* name      host             port */
+    { "mcu",     MCU_TARGET_HOST, MCU_TARGET_PORT },  /* primary            */
+    /* { "logger", "192.168.56.1", 5011u }, */        /* e.g. data logger   */
+    /* { "hil",    "192.168.56.20", 5001u }, */       /* e.g. HIL rig       */
+};
+
+/* Fixed-rate control loop: 0 forwards every command as it arrives; a rate
+ * (e.g. 100u) sends exactly one command per tick, repeating the last one
+ * until it expires.  Pair a rate with a coalescing mode below so ticks
+ * always pick up the newest command rather than a backlog. */
+#define MCU_TICK_RATE_HZ        0u
+
+/* Ack channel: when non-zero, every forwarded datagram carries a 4-byte
+ * id after the payload and the motor controller must echo that id back;
+ * ids not acked within this many ms count as missing.  0 sends plain
+ * ACKERMANN_PAYLOAD_SIZE datagrams. */
+#define MCU_ACK_TIMEOUT_MS      0u
+
+/* Silence watchdog: after this long without a received command the MCU
+ * thread forwards g_stop_payload, repeating it every interval until
+ * commands resume.  0 disables it.  Off by default: fill in
+ * g_stop_payload with a stop command agreed with the motor control team
+ * before enabling it (e.g. 500u). */
+#define MCU_WATCHDOG_MS         0u
+
+/* Stop/park command sent by the watchdog — must be a valid Ackermann
+ * payload for the motor control team.  The zeros are a placeholder, not
+ * a validated stop. */
+static const uint8_t g_stop_payload[ACKERMANN_PAYLOAD_SIZE] = { 0 };
+
+/* Inbound command sources of each channel, one UDP socket each, all
+ * served by the channel's interface thread.  The index in a channel's
+ * table is the source id used by POOL_COALESCE_SOURCE.  A command whose
+ * priority exceeds its source's ceiling is clamped to the ceiling.  The
+ * defaults (255) pass every priority through unchanged; lower a ceiling
+ * (e.g. nav 191, teleop 223) so the safety supervisor can always outrank
+ * the other senders, once they have agreed on the priority bands.
+ * bind_host NULL = all interfaces.  wfq_weight is the source's share of
+ * the MCU under POOL_SCHED_WFQ.  rate_limit_hz / rate_burst police each
+ * source with a token bucket so a flooding sender cannot fill the pool;
+ * datagrams over the limit are dropped and counted as throttled.  0 Hz =
+ * unlimited, the default; set a limit above each sender's real rate
+ * (e.g. 1000u, burst 64u) once it is known.  Source names must be unique
+ * across channels. */
+static const InterfaceSourceConfig g_drive_sources[] = {
+    /* name      port   bind_host  priority_ceiling  wfq_weight  rate_limit_hz  rate_burst */
+    { "nav",     5000u, NULL,      255u,             2u,         0u,            0u  },  /* navigation path planner  */
+    { "teleop",  5002u, NULL,      255u,             1u,         0u,            0u  },  /* teleoperation station    */
+    { "safety",  5003u, NULL,      255u,             4u,         0u,            0u  },  /* safety supervisor        */
+};
+
+/* Example tables for further channels (see g_channels below); the ports
+ * and controllers are placeholders.
+static const InterfaceSourceConfig g_aux_sources[] = {
+    { "aux",     5004u, NULL,      255u,             1u,         200u,          16u },  // auxiliary actuators
+};
+static const MCUTargetConfig g_aux_targets[] = {
+    { "aux",     MCU_TARGET_HOST, 5005u },
+};
+static const InterfaceSourceConfig g_lights_sources[] = {
+    { "lights",  5006u, NULL,      255u,             1u,         50u,           8u  },  // lights and indicators
+};
+static const MCUTargetConfig g_lights_targets[] = {
+    { "lights",  MCU_TARGET_HOST, 5007u },
+};
+*/
+
+/* Latest-wins mode for the drive pool: POOL_COALESCE_NONE queues every
+ * command, POOL_COALESCE_PRIORITY / POOL_COALESCE_SOURCE keep only the
+ * newest pending command per priority / per source. */
+#define POOL_COALESCE_MODE      POOL_COALESCE_NONE
+
+/* Behaviour when a pool is full.  EVICT_LOWEST makes room for a new
+ * command by dropping the oldest lower-or-equal priority one, so a flood
+ * of low-priority traffic can never push out urgent commands. */
+#define POOL_OVERLOAD_POLICY    POOL_OVERLOAD_EVICT_LOWEST
+
+/* Which queued command an MCU thread takes next: POOL_SCHED_STRICT
+ * (highest priority), _EDF (earliest freshness deadline), _AGING
+ * (priority plus one level per POOL_AGING_STEP_MS waited) or _WFQ
+ * (weighted fair share per source, see the source tables).  --sched NAME
+ * at run time selects the policy of every channel. */
+#define POOL_SCHED_POLICY       POOL_SCHED_STRICT
+#define POOL_AGING_STEP_MS      10u
+
+/* Command channels.  Each has its own sources, pool, interface and MCU
+ * threads and targets, so a flood on one never delays another (see
+ * channel.h).  Only the drive channel is built by default; the aux and
+ * lights entries show how to add more.  Thread priorities: 0 keeps the
+ * role default from rt_thread.c (interface 20, MCU 30); keep every
+ * channel above the DB logger (10), and the drive channel above the
+ * rest.  CPUs: -1 uses RT_CPU_INTERFACE / RT_CPU_MCU below; pinning needs
+ * hardened mode.  At most CHANNEL_MAX channels. */
+static const ChannelConfig g_channels[] = {
+    {   /* steering and throttle */
+        .name = "drive",
+        .sources = g_drive_sources,
+        .source_count = sizeof(g_drive_sources) / sizeof(g_drive_sources[0]),
+        .targets = g_drive_targets,
+        .target_count = sizeof(g_drive_targets) / sizeof(g_drive_targets[0]),
+        .coalesce = POOL_COALESCE_MODE,
+        .overload = POOL_OVERLOAD_POLICY,
+        .sched = POOL_SCHED_POLICY,
+        .aging_step_ms = POOL_AGING_STEP_MS,
+        .tick_rate_hz = MCU_TICK_RATE_HZ,
+        .ack_timeout_ms = MCU_ACK_TIMEOUT_MS,
+        .watchdog_ms = MCU_WATCHDOG_MS,
+        .stop_payload = g_stop_payload,
+        .interface_thread = { 0, -1 },   /* priority, CPU */
+        .mcu_thread = { 0, -1 },
+    },
+    /*
+    {   // auxiliary actuators; they hold their last command, no watchdog
+        .name = "aux",
+        .sources = g_aux_sources,
+        .source_count = sizeof(g_aux_sources) / sizeof(g_aux_sources[0]),
+        .targets = g_aux_targets,
+        .target_count = sizeof(g_aux_targets) / sizeof(g_aux_targets[0]),
+        .coalesce = POOL_COALESCE_NONE,
+        .overload = POOL_OVERLOAD_POLICY,
+        .sched = POOL_SCHED_POLICY,
+        .aging_step_ms = POOL_AGING_STEP_MS,
+        .interface_thread = { 16, -1 },
+        .mcu_thread = { 18, -1 },
+    },
+    {   // lights: only the newest state matters
+        .name = "lights",
+        .sources = g_lights_sources,
+        .source_count = sizeof(g_lights_sources) / sizeof(g_lights_sources[0]),
+        .targets = g_lights_targets,
+        .target_count = sizeof(g_lights_targets) / sizeof(g_lights_targets[0]),
+        .coalesce = POOL_COALESCE_SOURCE,
+        .overload = POOL_OVERLOAD_POLICY,
+        .sched = POOL_SCHED_POLICY,
+        .aging_step_ms = POOL_AGING_STEP_MS,
+        .interface_thread = { 12, -1 },
+        .mcu_thread = { 14, -1 },
+    },
+    */
+};
+#define CHANNEL_COUNT (sizeof(g_channels) / sizeof(g_channels[0]))
+
+_Static_assert(CHANNEL_COUNT >= 1 && CHANNEL_COUNT <= CHANNEL_MAX, "main: 1..CHANNEL_MAX channels");
+_Static_assert(CAPTURE_MAX_RINGS >= CHANNEL_MAX, "main: one capture ring per channel");
+
+/* Database logging: DBLOG_SUMMARY_MS 0 logs every command.  Non-zero
+ * (e.g. 1000) makes the DB logger send a few summary rows per interval
+ * (counts per priority, drops, expiries, latency min/avg/max) instead of
+ * a row per received and per forwarded command, plus every
+ * DBLOG_SAMPLE_EVERY-th command on its own (0 = no per-command rows). */
+#define DBLOG_SUMMARY_MS        0u
+#define DBLOG_SAMPLE_EVERY      100u
+
+/* Real-time hardening: lock all memory, give every thread a prefaulted
+ * fixed-size stack, use real-time policies on Linux as well as QNX and
+ * pin threads to the CPUs below (per channel, see g_channels).  Also
+ * enabled with --rt at run time. */
+#define RT_HARDEN               0
+#define RT_CPU_INTERFACE        (-1)        /* CPU per thread, -1 = any    */
+#define RT_CPU_MCU              (-1)
+#define RT_CPU_DBLOG            (-1)
+
 /* -----------------------------------------------------------------------
  * Graceful shutdown
  * ----------------------------------------------------------------------- */
-static volatile int g_running = 1;
+static volatile sig_atomic_t g_running = 1;
+static volatile sig_atomic_t g_dump_requested = 0;
 
 static void signal_handler(int sig)
 {
@@ -29,14 +202,83 @@ static void signal_handler(int sig)
     g_running = 0;
 }
 
+/* SIGUSR1: print latency histograms from the main thread. */
+static void dump_handler(int sig)
+{
+    (void)sig;
+    g_dump_requested = 1;
+}
+
+/* -----------------------------------------------------------------------
+ * DB summary counters
+ * ----------------------------------------------------------------------- */
+
+/* Totals for the DB logger's interval summaries, over every channel; runs
+ * on the logger thread and only reads the thread-safe stats snapshots. */
+static void db_counters(void *ctx, DbLogCounters *out)
+{
+    Channel *channels = (Channel *)ctx;
+
+    out->dropped = 0;
+    out->expired = 0;
+    out->throttled = 0;
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+        ChannelStats cs;
+        channel_get_stats(&channels[c], &cs);
+        out->dropped += cs.dropped;
+        out->expired += cs.expired;
+        out->throttled += cs.throttled;
+    }
+}
+
 /* -----------------------------------------------------------------------
  * main
  * ----------------------------------------------------------------------- */
-int main(void)
+int main(int argc, char **argv)
 {
+    /* --- Real-time hardening, before anything is allocated or any
+     *     thread is started.                                       --- */
+    RtConfig rt;
+    rt.harden = RT_HARDEN;
+    rt.cpu[RT_THREAD_INTERFACE] = RT_CPU_INTERFACE;
+    rt.cpu[RT_THREAD_MCU] = RT_CPU_MCU;
+    rt.cpu[RT_THREAD_DBLOG] = RT_CPU_DBLOG;
+    const char *capture_path = NULL;
+    int sched_override = 0;
+    PoolSchedPolicy sched = POOL_SCHED_POLICY;
+    for (int i = 1; i < argc; ++i) {
+        if (strcmp(argv[i], "--rt") == 0) {
+            rt.harden = 1;
+        } else if (strcmp(argv[i], "--capture") == 0 && i + 1 < argc) {
+            capture_path = argv[++i];
+        } else if (strcmp(argv[i], "--sched") == 0 && i + 1 < argc) {
+            const char *name = argv[++i];
+            unsigned p;
+            for (p = 0; p < POOL_SCHED_POLICY_COUNT; ++p) {
+                if (strcmp(name, pool_sched_policy_name((PoolSchedPolicy)p)) == 0)
+                    break;
+            }
+            if (p == POOL_SCHED_POLICY_COUNT) {
+                fprintf(stderr, "main: unknown --sched %s (strict, edf, aging, wfq)\n", name);
+                return EXIT_FAILURE;
+            }
+            sched = (PoolSchedPolicy)p;
+            sched_override = 1;
+        } else {
+            fprintf(stderr, "usage: %s [--rt] [--capture FILE] [--sched strict|edf|aging|wfq]\n",
+                    argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (rt_configure(&rt) != 0) {
+        fprintf(stderr, "main: memory not locked, continuing without it\n");
+        // Continue anyway
+    }
+
     /* --- Wire up signal handling. --- */
     signal(SIGINT,  signal_handler);
     signal(SIGTERM, signal_handler);
+    signal(SIGUSR1, dump_handler);
 
     /* --- Open message queue for logging startup. --- */
     mqd_t mqd = mq_open("/db_queue", O_WRONLY | O_NONBLOCK);
@@ -45,75 +287,150 @@ int main(void)
         // Continue anyway
     }
 
-    /* --- Shared command pool. --- */
-    CommandPool pool;
-    if (pool_init(&pool) != 0) {
-        fprintf(stderr, "main: failed to initialise command pool\n");
-        return EXIT_FAILURE;
-    } else {
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table));
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        strncpy(msg.msg, "Command pool initialized", sizeof(msg.msg));
-        if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+    /* --- Asynchronous DB logger: one ring per real-time thread, drained
+     *     by a low-priority thread.  Without /db_queue the rings simply
+     *     fill up and the overflow is counted.                      --- */
+    static DbLogger dblog; /* holds the log rings — keep off the stack */
+    dblog_init(&dblog);
+
+    /* --- Command channels: pool, interface (inbound UDP) and MCU logic
+     *     (outbound UDP + scheduling) each.                          --- */
+    static Channel channels[CHANNEL_COUNT]; /* hold the pools — keep off the stack */
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+        ChannelConfig cfg = g_channels[c];
+        if (sched_override)
+            cfg.sched = sched;
+        if (channel_init(&channels[c], &cfg, &dblog) != 0) {
+            fprintf(stderr, "main: failed to initialise channel %s\n", cfg.name);
+            for (size_t k = 0; k < c; ++k)
+                channel_destroy(&channels[k]);
+            dblog_stop(&dblog);
+            dblog_destroy(&dblog);
+            return EXIT_FAILURE;
+        } else {
+            DB_t msg;
+            strncpy(msg.table, "logs", sizeof(msg.table));
+            strncpy(msg.id, "cmd", sizeof(msg.id));
+            snprintf(msg.msg, sizeof(msg.msg), "Channel %s initialized", cfg.name);
+            if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+        }
     }
 
-    /* --- Command interface (inbound UDP). --- */
-    CommandInterface iface;
-    if (interface_init(&iface, INTERFACE_LISTEN_PORT, &pool) != 0) {
-        fprintf(stderr, "main: failed to initialise command interface\n");
-        pool_destroy(&pool);
-        return EXIT_FAILURE;
-    } else {
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table));
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        strncpy(msg.msg, "Command interface initialized", sizeof(msg.msg));
-        if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+    /* --- Start the DB logger now that the channels its summaries read
+     *     exist; nothing is logged before the channel threads start. --- */
+    dblog_set_summary(&dblog, DBLOG_SUMMARY_MS, DBLOG_SAMPLE_EVERY, db_counters, channels);
+    if (dblog_start(&dblog) != 0) {
+        fprintf(stderr, "main: DB logger not started, command logging disabled\n");
+        // Continue anyway
     }
 
-    /* --- MCU logic (outbound UDP + scheduling). --- */
-    MCULogic mcu;
-    if (mcu_init(&mcu, &pool, MCU_TARGET_HOST, MCU_TARGET_PORT) != 0) {
-        fprintf(stderr, "main: failed to initialise MCU logic\n");
-        interface_destroy(&iface);
-        pool_destroy(&pool);
-        return EXIT_FAILURE;
-    } else {
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table));
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        strncpy(msg.msg, "MCU logic initialized", sizeof(msg.msg));
-        if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+    /* --- Traffic capture for cp_replay, with --capture FILE: one file,
+     *     one ring per channel, source ids numbered across channels in
+     *     table order.  Started before the interfaces so no datagram is
+     *     missed.                                                     --- */
+    static Capture capture; /* holds the capture rings — keep off the stack */
+    int capturing = 0;
+    if (capture_path) {
+        CaptureSource cs[CHANNEL_MAX * INTERFACE_MAX_SOURCES];
+        size_t n = 0;
+        for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+            for (size_t i = 0; i < g_channels[c].source_count; ++i) {
+                cs[n].name = g_channels[c].sources[i].name;
+                cs[n].port = g_channels[c].sources[i].port;
+                ++n;
+            }
+        }
+        if (capture_open(&capture, capture_path, cs, n) != 0) {
+            fprintf(stderr, "main: capture to %s not started\n", capture_path);
+            // Continue anyway
+        } else {
+            size_t first_id = 0;
+            for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+                interface_set_capture(&channels[c].iface, capture_register(&capture),
+                                      (uint8_t)first_id);
+                first_id += g_channels[c].source_count;
+            }
+            if (capture_start(&capture) != 0) {
+                fprintf(stderr, "main: capture to %s not started\n", capture_path);
+                for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+                    interface_set_capture(&channels[c].iface, NULL, 0);
+                capture_close(&capture);
+                // Continue anyway
+            } else {
+                capturing = 1;
+            }
+        }
     }
 
-    /* --- Start both threads. --- */
-    if (interface_start(&iface) != 0) {
-        fprintf(stderr, "main: failed to start command interface thread\n");
-        goto cleanup;
-    } else {
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table));
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        strncpy(msg.msg, "Command interface thread started", sizeof(msg.msg));
-        if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+    /* --- Live metrics page for cp_stat.  Optional. --- */
+    MetricsPublisher metrics;
+    if (metrics_open(&metrics) != 0) {
+        fprintf(stderr, "main: metrics page not available, cp_stat disabled\n");
+        // Continue anyway
     }
 
-    if (mcu_start(&mcu) != 0) {
-        fprintf(stderr, "main: failed to start MCU logic thread\n");
-        interface_stop(&iface);
-        goto cleanup;
-    } else {
-        DB_t msg;
-        strncpy(msg.table, "logs", sizeof(msg.table));
-        strncpy(msg.id, "cmd", sizeof(msg.id));
-        strncpy(msg.msg, "MCU logic thread started", sizeof(msg.msg));
-        if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+    /* --- Start every channel's threads. --- */
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+        if (channel_start(&channels[c]) != 0) {
+            fprintf(stderr, "main: failed to start channel %s\n", g_channels[c].name);
+            for (size_t k = 0; k < c; ++k)
+                channel_stop(&channels[k]);
+            dblog_stop(&dblog);
+            capture_stop(&capture);
+            goto cleanup;
+        } else {
+            DB_t msg;
+            strncpy(msg.table, "logs", sizeof(msg.table));
+            strncpy(msg.id, "cmd", sizeof(msg.id));
+            snprintf(msg.msg, sizeof(msg.msg), "Channel %s threads started", g_channels[c].name);
+            if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
+        }
     }
 
-    printf("Command processor running.  "
-           "Listening on :%u, forwarding to %s:%u\n",
-           INTERFACE_LISTEN_PORT, MCU_TARGET_HOST, MCU_TARGET_PORT);
+    printf("Command processor running%s.  %zu channel(s)\n",
+           rt.harden ? " (real-time hardened)" : "", (size_t)CHANNEL_COUNT);
+    if (DBLOG_SUMMARY_MS == 0) {
+        printf("  DB log: every command\n");
+    } else if (DBLOG_SAMPLE_EVERY == 0) {
+        printf("  DB log: %u ms summaries\n", (unsigned)DBLOG_SUMMARY_MS);
+    } else {
+        printf("  DB log: %u ms summaries, 1 in %u commands logged individually\n",
+               (unsigned)DBLOG_SUMMARY_MS, (unsigned)DBLOG_SAMPLE_EVERY);
+    }
+    if (capturing) {
+        printf("  capturing inbound traffic to %s\n", capture_path);
+    }
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+        const ChannelConfig *cfg = &channels[c].cfg;
+        printf("  channel %-8s -> %s:%u  scheduling %s", cfg->name,
+               cfg->targets[0].host, (unsigned)cfg->targets[0].port,
+               pool_sched_policy_name(cfg->sched));
+        if (cfg->interface_thread.priority != 0 || cfg->mcu_thread.priority != 0) {
+            printf("  priority interface %d mcu %d",
+                   cfg->interface_thread.priority, cfg->mcu_thread.priority);
+        }
+        if (cfg->interface_thread.cpu >= 0 || cfg->mcu_thread.cpu >= 0) {
+            printf("  cpu interface %d mcu %d",
+                   cfg->interface_thread.cpu, cfg->mcu_thread.cpu);
+        }
+        printf("\n");
+        for (size_t i = 1; i < cfg->target_count; ++i) {
+            printf("    mirror %-8s %s:%u\n", cfg->targets[i].name,
+                   cfg->targets[i].host, (unsigned)cfg->targets[i].port);
+        }
+        for (size_t i = 0; i < cfg->source_count; ++i) {
+            const InterfaceSourceConfig *src = &cfg->sources[i];
+            printf("    source %zu %-8s :%u  priority ceiling %u  weight %u", i,
+                   src->name, (unsigned)src->port,
+                   (unsigned)src->priority_ceiling,
+                   src->wfq_weight ? (unsigned)src->wfq_weight : 1u);
+            if (src->rate_limit_hz != 0) {
+                printf("  limit %u/s burst %u", (unsigned)src->rate_limit_hz,
+                       src->rate_burst ? (unsigned)src->rate_burst : 1u);
+            }
+            printf("\n");
+        }
+    }
 
     {
         DB_t msg;
@@ -123,19 +440,61 @@ int main(void)
         if (mqd != (mqd_t)-1) mq_send(mqd, (char*)&msg, sizeof(DB_t), 0);
     }
 
-    /* --- Main thread idles until a signal is received. --- */
-    while (g_running)
-        sleep(1);
+    /* --- Main thread publishes metrics until a signal is received;
+     *     the period also bounds how long a shutdown request waits.
+     *     `kill -USR1 <pid>` dumps the latency histograms.   --- */
+    const struct timespec publish_period = {0, METRICS_PUBLISH_MS * 1000000L};
+    while (g_running) {
+        nanosleep(&publish_period, NULL);
+        metrics_publish(&metrics, channels, CHANNEL_COUNT);
+        if (g_dump_requested) {
+            g_dump_requested = 0;
+            for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+                printf("Channel %s:\n", g_channels[c].name);
+                interface_dump_transit(&channels[c].iface, stdout);
+                mcu_dump_latency(&channels[c].mcu, stdout);
+            }
+        }
+    }
 
     printf("\nShutdown requested — stopping threads...\n");
 
-    interface_stop(&iface);
-    mcu_stop(&mcu);
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+        channel_stop(&channels[c]);
+    dblog_stop(&dblog); /* after the producers: flushes what they logged */
+    capture_stop(&capture); /* likewise, after the interfaces */
+
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+        channel_print_stats(&channels[c], stdout);
+    DbLogStats ls;
+    dblog_get_stats(&dblog, &ls);
+    printf("DB log: sent=%llu send_failed=%llu overflow=%llu\n",
+           (unsigned long long)ls.sent,
+           (unsigned long long)ls.send_failed,
+           (unsigned long long)ls.overflow);
+    if (capturing) {
+        CaptureStats cs;
+        capture_get_stats(&capture, &cs);
+        printf("Capture %s: captured=%llu written=%llu overflow=%llu write_failed=%llu\n",
+               capture_path,
+               (unsigned long long)cs.captured,
+               (unsigned long long)cs.written,
+               (unsigned long long)cs.overflow,
+               (unsigned long long)cs.write_failed);
+    }
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c) {
+        printf("Channel %s:\n", g_channels[c].name);
+        interface_dump_transit(&channels[c].iface, stdout);
+        mcu_dump_latency(&channels[c].mcu, stdout);
+    }
 
+    /* Every thread is stopped by now, on either path. */
 cleanup:
-    mcu_destroy(&mcu);
-    interface_destroy(&iface);
-    pool_destroy(&pool);
+    metrics_close(&metrics);
+    dblog_destroy(&dblog);
+    capture_close(&capture);
+    for (size_t c = 0; c < CHANNEL_COUNT; ++c)
+        channel_destroy(&channels[c]);
     mq_close(mqd);
 
     printf("Command processor stopped.\n");
@@ -1,102 +1,524 @@
+#define _GNU_SOURCE /* sendmmsg on glibc */
 #include "mcu_logic.h"
+#include "rt_thread.h"
+#include "rx_timestamp.h"
 
 #include <arpa/inet.h>
 #include <errno.h>
 #include <fcntl.h>
-#include <mqueue.h>
 #include <stdio.h>
 #include <string.h>
 #include <sys/socket.h>
 #include <time.h>
 #include <unistd.h>
 
+/* Upper bound on how long the scheduling thread waits in the pool before
+ * re-checking mcu->running. */
+#define MCU_POLL_INTERVAL_MS 100L
+
+/* Batched transmit is available on Linux and QNX 7+; elsewhere fall back
+ * to one sendto per command. */
+#if defined(__linux__) || defined(__QNXNTO__)
+#define MCU_HAVE_SENDMMSG 1
+#endif
+
 /* -----------------------------------------------------------------------
  * Internal helpers
  * ----------------------------------------------------------------------- */
 
+static inline void ns_to_timespec(uint64_t ns, struct timespec *ts)
+{
+    ts->tv_sec = (time_t)(ns / 1000000000ull);
+    ts->tv_nsec = (long)(ns % 1000000000ull);
+}
+
+/* Queue the database record of one forwarded command. */
+static void log_forwarded(MCULogic *mcu, const PoolEntry *cmd, uint64_t send_ns,
+                          uint64_t latency_ns)
+{
+    DbLogRecord rec;
+    rec.source = NULL;
+    rec.time_ns = send_ns;
+    rec.freshness_ms = 0;
+    rec.latency_ns = (latency_ns > UINT32_MAX) ? UINT32_MAX : (uint32_t)latency_ns;
+    rec.kind = DBLOG_FORWARDED;
+    rec.priority = cmd->priority;
+    dblog_write(mcu->log, &rec);
+}
+
+/* Counters have a single writer each; see the matching helpers in
+ * command_pool.c. */
+static inline void stat_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, *counter + n, __ATOMIC_RELAXED);
+}
+
+static inline uint64_t stat_read(const uint64_t *counter)
+{
+    return __atomic_load_n(counter, __ATOMIC_RELAXED);
+}
+
+/* Outgoing batch, built once and sent to every target.  Targets are
+ * connected sockets, so the messages carry no address.  With acks on,
+ * each payload is followed by its id tag (second iovec). */
+typedef struct
+{
+    size_t n;
+    uint8_t tags[MCU_BATCH_MAX][MCU_ACK_TAG_SIZE];
+    struct iovec iov[MCU_BATCH_MAX][2];
+#ifdef MCU_HAVE_SENDMMSG
+    struct mmsghdr msgs[MCU_BATCH_MAX];
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+    } msgs[MCU_BATCH_MAX];
+#endif
+} TxBatch;
+
+/* Build the batch for cmds[0..n).  tagged selects the ack tag; ids run
+ * from first_id upwards. */
+static void tx_batch_init(TxBatch *tx, const PoolEntry *cmds, size_t n,
+                          int tagged, uint32_t first_id)
+{
+    tx->n = n;
+    memset(tx->msgs, 0, n * sizeof(tx->msgs[0]));
+    for (size_t i = 0; i < n; ++i)
+    {
+        tx->iov[i][0].iov_base = (void *)cmds[i].ackermann_bytes;
+        tx->iov[i][0].iov_len = ACKERMANN_PAYLOAD_SIZE;
+        if (tagged)
+        {
+            uint32_t id = first_id + (uint32_t)i;
+            tx->tags[i][0] = (uint8_t)(id >> 24);
+            tx->tags[i][1] = (uint8_t)(id >> 16);
+            tx->tags[i][2] = (uint8_t)(id >> 8);
+            tx->tags[i][3] = (uint8_t)id;
+            tx->iov[i][1].iov_base = tx->tags[i];
+            tx->iov[i][1].iov_len = MCU_ACK_TAG_SIZE;
+        }
+        tx->msgs[i].msg_hdr.msg_iov = tx->iov[i];
+        tx->msgs[i].msg_hdr.msg_iovlen = tagged ? 2 : 1;
+    }
+}
+
+/* One send call for the commands from index done on.  Returns the number
+ * sent, or -1 with errno set. */
+static int tx_send(int fd, TxBatch *tx, size_t done, int flags)
+{
+#ifdef MCU_HAVE_SENDMMSG
+    return sendmmsg(fd, &tx->msgs[done], (unsigned)(tx->n - done), flags);
+#else
+    return (sendmsg(fd, &tx->msgs[done].msg_hdr, flags) < 0) ? -1 : 1;
+#endif
+}
+
 /*
- * Forward the raw Ackermann bytes to the motor control team.
- * Returns 0 on success, -1 on error.
+ * Send the whole batch to one target and record how long it took.  The
+ * primary socket blocks; a mirror socket never blocks, so whatever does
+ * not fit is counted as dropped.  Send errors are only counted — this
+ * runs on the scheduling thread, which must not block on stdio.  Sets *end_ns
+ * to the time the send finished.
+ * Returns the number of commands sent.
  */
-static int forward_command(MCULogic *mcu, const PoolEntry *cmd)
+static size_t send_target(MCUTarget *t, int primary, TxBatch *tx, uint64_t *end_ns)
 {
-    ssize_t sent = sendto(mcu->sock_fd,
-                          cmd->ackermann_bytes,
-                          ACKERMANN_PAYLOAD_SIZE,
-                          0,
-                          (const struct sockaddr *)&mcu->mcu_addr,
-                          sizeof(mcu->mcu_addr));
+    const int flags = primary ? 0 : MSG_DONTWAIT;
+    int refused_retry = 1;
+    size_t done = 0;
+    uint64_t start_ns = monotonic_now_ns();
 
-    if (sent < 0)
+    while (done < tx->n)
     {
-        perror("mcu: forward_command: sendto");
-        return -1;
+        int sent = tx_send(t->sock_fd, tx, done, flags);
+        if (sent >= 0)
+        {
+            done += (size_t)sent;
+            continue;
+        }
+        if (errno == EINTR)
+            continue;
+
+        stat_add(&t->stats.errors, 1);
+        if (errno == ECONNREFUSED && refused_retry)
+        {
+            /* ICMP port unreachable from an earlier datagram, reported on
+             * a connected socket; this batch has not been sent yet. */
+            refused_retry = 0;
+            continue;
+        }
+        stat_add(&t->stats.dropped, tx->n - done);
+        break;
     }
 
-    if ((size_t)sent != ACKERMANN_PAYLOAD_SIZE)
+    *end_ns = monotonic_now_ns();
+    lat_hist_record(&t->send_latency, *end_ns - start_ns);
+    stat_add(&t->stats.sent, done);
+    return done;
+}
+
+/* -----------------------------------------------------------------------
+ * Ack channel
+ *
+ * Ids are consecutive, so the outstanding ones always lie in
+ * [ack_oldest_id, ack_next_id) and each maps to window slot id % window.
+ * The thread drains acks without blocking whenever it wakes; a pending id
+ * older than the timeout, or one whose slot is needed for a new id, is
+ * counted as missing.
+ * ----------------------------------------------------------------------- */
+
+/* Most acks read per drain, so a flood cannot hold the thread. */
+#define MCU_ACK_DRAIN_MAX 64u
+
+/* Record the ids of a batch just sent: n ids used, the first done of
+ * them reached the primary at about send_ns. */
+static void ack_track(MCULogic *mcu, size_t n, size_t done, uint64_t send_ns)
+{
+    for (size_t i = 0; i < n; ++i)
     {
-        fprintf(stderr, "mcu: forward_command: partial send (%zd / %u bytes)\n",
-                sent, (unsigned)ACKERMANN_PAYLOAD_SIZE);
-        return -1;
+        uint32_t id = mcu->ack_next_id++;
+        MCUAckSlot *slot = &mcu->ack_window[id & (MCU_ACK_WINDOW - 1u)];
+        if (slot->pending)
+            stat_add(&mcu->ack_stats.missing, 1);
+
+        slot->id = id;
+        slot->pending = (i < done);
+        slot->send_ns = send_ns;
     }
+    stat_add(&mcu->ack_stats.tagged, done);
 
-    // Log send time for database entry
-    struct timespec send_time;
-    clock_gettime(CLOCK_MONOTONIC, &send_time);
+    if (mcu->ack_next_id - mcu->ack_oldest_id > MCU_ACK_WINDOW)
+        mcu->ack_oldest_id = mcu->ack_next_id - MCU_ACK_WINDOW;
+}
 
-    // Add to database
-    DB_t msg;
-    strncpy(msg.table, "logs", sizeof(msg.table)); // "sensors", "states", or "logs"
-    strncpy(msg.id, "cmd", sizeof(msg.id));
-    snprintf(msg.msg, sizeof(msg.msg), "Command Forwarded: Priority: %u Time: %ld.%09ld",
-             cmd->priority,
-             send_time.tv_sec,
-             send_time.tv_nsec);
+/* Match whatever acks are queued on the primary socket, then expire
+ * pending ids older than the timeout. */
+static void ack_drain(MCULogic *mcu)
+{
+    const int fd = mcu->targets[0].sock_fd;
+    uint64_t now_ns;
+    int64_t real_to_mono_ns = rx_real_to_mono_ns(&now_ns);
 
-    if (mq_send(mqd, (char *)&msg, sizeof(DB_t), 0) == -1)
+    for (unsigned k = 0; k < MCU_ACK_DRAIN_MAX; ++k)
     {
-        perror("mq_send");
+        uint8_t buf[MCU_ACK_TAG_SIZE];
+        RxControl control;
+        struct iovec iov = {buf, sizeof(buf)};
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control.buf;
+        msg.msg_controllen = sizeof(control.buf);
+
+        ssize_t len = recvmsg(fd, &msg, MSG_DONTWAIT);
+        if (len < 0)
+        {
+            if (errno == EINTR || errno == ECONNREFUSED)
+                continue; /* ICMP error for an earlier send — keep reading */
+            if (errno != EAGAIN && errno != EWOULDBLOCK)
+                stat_add(&mcu->targets[0].stats.errors, 1);
+            break;
+        }
+        if ((size_t)len < MCU_ACK_TAG_SIZE)
+        {
+            stat_add(&mcu->ack_stats.unmatched, 1);
+            continue;
+        }
+
+        uint32_t id = ((uint32_t)buf[0] << 24) | ((uint32_t)buf[1] << 16) |
+                      ((uint32_t)buf[2] << 8) | (uint32_t)buf[3];
+        MCUAckSlot *slot = &mcu->ack_window[id & (MCU_ACK_WINDOW - 1u)];
+        if (!slot->pending || slot->id != id)
+        {
+            stat_add(&mcu->ack_stats.unmatched, 1);
+            continue;
+        }
+
+        uint64_t ack_ns = rx_timestamp_ns(&msg, real_to_mono_ns, now_ns);
+        lat_hist_record(&mcu->ack_rtt, (ack_ns > slot->send_ns) ? ack_ns - slot->send_ns : 0u);
+        stat_add(&mcu->ack_stats.acked, 1);
+        slot->pending = 0;
     }
-    else
+
+    /* Expire from the oldest id forward; stop at the first that is still
+     * within its timeout. */
+    while (mcu->ack_oldest_id != mcu->ack_next_id)
     {
-        printf("Sent to DB: table=%s id=%s msg=%s\n", msg.table, msg.id, msg.msg);
+        MCUAckSlot *slot = &mcu->ack_window[mcu->ack_oldest_id & (MCU_ACK_WINDOW - 1u)];
+        if (slot->pending)
+        {
+            if (now_ns - slot->send_ns < mcu->ack_timeout_ns)
+                break;
+            slot->pending = 0;
+            stat_add(&mcu->ack_stats.missing, 1);
+        }
+        mcu->ack_oldest_id++;
     }
+}
 
-    return 0;
+/*
+ * Send the raw Ackermann bytes of a batch of commands to every target, in
+ * the order given (best first): the primary first, then each mirror.  Uses
+ * one sendmmsg call per target where available.  If sent_ns is not NULL it
+ * receives the time the primary send finished.
+ * Returns the number of commands sent to the primary.
+ */
+static size_t send_batch(MCULogic *mcu, const PoolEntry *cmds, size_t n, uint64_t *sent_ns)
+{
+    TxBatch tx;
+    uint64_t primary_ns, mirror_ns;
+    const int tagged = (mcu->ack_timeout_ns != 0);
+    uint64_t tag_ns = tagged ? monotonic_now_ns() : 0u;
+
+    tx_batch_init(&tx, cmds, n, tagged, mcu->ack_next_id);
+    size_t done = send_target(&mcu->targets[0], 1, &tx, &primary_ns);
+    if (tagged)
+        ack_track(mcu, n, done, tag_ns);
+    for (size_t t = 1; t < mcu->target_count; ++t)
+        send_target(&mcu->targets[t], 0, &tx, &mirror_ns);
+
+    if (sent_ns)
+        *sent_ns = primary_ns;
+    return done;
+}
+
+/*
+ * Forward newly popped commands: send them, then record their latency
+ * and queue their database records.
+ * Returns 0 if every command was sent, -1 on error.
+ */
+static int forward_batch(MCULogic *mcu, const PoolEntry *cmds, size_t n)
+{
+    // Log send time for database entry
+    uint64_t send_ns;
+    size_t done = send_batch(mcu, cmds, n, &send_ns);
+
+    uint64_t latency_ns[MCU_BATCH_MAX];
+    for (size_t i = 0; i < done; ++i)
+    {
+        latency_ns[i] = (send_ns > cmds[i].recv_ns) ? send_ns - cmds[i].recv_ns : 0u;
+        lat_hist_record(&mcu->latency[cmds[i].priority], latency_ns[i]);
+    }
+
+    for (size_t i = 0; i < done; ++i)
+        log_forwarded(mcu, &cmds[i], send_ns, latency_ns[i]);
+
+    return (done == n) ? 0 : -1;
 }
 
 /* -----------------------------------------------------------------------
- * Scheduling thread
+ * Silence watchdog
+ *
+ * watchdog_due_ns is the time the stop payload goes out unless a command
+ * arrives first.  Feeding it costs one compare and a store per batch and
+ * uses the receive stamps already in the entries, so the normal path
+ * makes no extra clock reads.  The deadline is only checked when the
+ * thread wakes without a command to send, and the pool wait is capped at
+ * the deadline, so the reaction time beyond the silence interval is one
+ * semaphore wake-up (event-driven) or at most one tick (fixed-rate).
  * ----------------------------------------------------------------------- */
 
-static void *mcu_thread(void *arg)
+/* A command received at recv_ns pushes the deadline out. */
+static inline void watchdog_feed(MCULogic *mcu, uint64_t recv_ns)
 {
-    MCULogic *mcu = (MCULogic *)arg;
+    uint64_t due = recv_ns + mcu->watchdog_ns;
+    if (mcu->watchdog_tripped || due > mcu->watchdog_due_ns)
+    {
+        mcu->watchdog_due_ns = due;
+        mcu->watchdog_tripped = 0;
+    }
+}
 
-    // Open message queue to write
-    mqd = mq_open("/db_queue", O_WRONLY | O_NONBLOCK);
-    if (mqd == (mqd_t)-1)
+/* Send the stop payload if the deadline has passed.  The first stop of a
+ * silence records the reaction time and a database record; repeats go out
+ * every interval.  Returns 1 if the deadline had passed. */
+static int watchdog_poll(MCULogic *mcu, uint64_t now_ns)
+{
+    if (mcu->watchdog_ns == 0 || now_ns < mcu->watchdog_due_ns)
+        return 0;
+
+    uint64_t sent_ns;
+    if (send_batch(mcu, &mcu->stop_cmd, 1, &sent_ns) == 1)
     {
-        perror("mq_open");
-        return NULL;
+        if (!mcu->watchdog_tripped)
+        {
+            mcu->watchdog_tripped = 1;
+            stat_add(&mcu->watchdog_stats.trips, 1);
+            lat_hist_record(&mcu->watchdog_reaction, sent_ns - mcu->watchdog_due_ns);
+
+            DbLogRecord rec;
+            rec.source = NULL;
+            rec.time_ns = sent_ns;
+            rec.freshness_ms = (uint32_t)(mcu->watchdog_ns / 1000000ull);
+            rec.latency_ns = 0;
+            rec.kind = DBLOG_WATCHDOG;
+            rec.priority = mcu->stop_cmd.priority;
+            dblog_write(mcu->log, &rec);
+        }
+        stat_add(&mcu->watchdog_stats.stops_sent, 1);
+        now_ns = sent_ns;
     }
 
+    /* Retry or repeat one interval later, even after a failed send, so a
+     * dead socket cannot turn the loop into a busy spin. */
+    mcu->watchdog_due_ns = now_ns + mcu->watchdog_ns;
+    return 1;
+}
+
+/* -----------------------------------------------------------------------
+ * Scheduling thread
+ * ----------------------------------------------------------------------- */
+
+/* Event-driven mode: forward commands as soon as they arrive. */
+static void run_event_driven(MCULogic *mcu)
+{
     while (mcu->running)
     {
-        /* --- 1. Block until the highest-priority valid command is available.
-         *        pool_pop_best handles expiry and ordering internally.    --- */
-        PoolEntry current;
-        if (pool_pop_best(mcu->pool, &current) != 0)
+        /* --- 1. Wait for the highest-priority valid commands.
+         *        pool_pop_batch handles expiry and ordering internally
+         *        and returns whatever is ready (up to MCU_BATCH_MAX) in
+         *        priority order; the timeout bounds how long a stop
+         *        request can go unnoticed and never runs past the
+         *        watchdog deadline.                                     --- */
+        uint64_t wait_ns = monotonic_now_ns() + MCU_POLL_INTERVAL_MS * 1000000ull;
+        if (mcu->watchdog_ns != 0 && mcu->watchdog_due_ns < wait_ns)
+            wait_ns = mcu->watchdog_due_ns;
+
+        struct timespec deadline;
+        ns_to_timespec(wait_ns, &deadline);
+
+        PoolEntry batch[MCU_BATCH_MAX];
+        int n = pool_pop_batch(mcu->pool, batch, MCU_BATCH_MAX, &deadline);
+        if (n == 0)
         {
-            fprintf(stderr, "mcu_thread: pool_pop_best error\n");
+            /* Timed out — check the watchdog, then re-check running. */
+            watchdog_poll(mcu, monotonic_now_ns());
+            if (mcu->ack_timeout_ns != 0)
+                ack_drain(mcu);
+            continue;
+        }
+        if (n < 0)
+        {
+            stat_add(&mcu->tick_stats.errors, 1);
             continue;
         }
 
-        /* --- 2. Forward the raw Ackermann payload to motor control. --- */
-        forward_command(mcu, &current);
+        /* --- 2. Forward the raw Ackermann payloads to motor control,
+         *        best first, in one syscall where possible.          --- */
+        forward_batch(mcu, batch, (size_t)n);
+
+        if (mcu->watchdog_ns != 0)
+        {
+            uint64_t newest_ns = batch[0].recv_ns;
+            for (int i = 1; i < n; ++i)
+                if (batch[i].recv_ns > newest_ns)
+                    newest_ns = batch[i].recv_ns;
+            watchdog_feed(mcu, newest_ns);
+        }
+
+        if (mcu->ack_timeout_ns != 0)
+            ack_drain(mcu);
     }
+}
+
+/*
+ * Fixed-rate mode: one command per tick at absolute deadlines, so the
+ * output rate does not depend on how commands arrive.  Each tick sends the
+ * best fresh command, or re-sends the last one sent while it is still
+ * valid, or nothing.  A tick that wakes after the next deadline has
+ * already passed counts the missed deadlines as overruns and realigns to
+ * the period grid instead of bursting to catch up.
+ */
+static void run_fixed_rate(MCULogic *mcu)
+{
+    const uint64_t period_ns = 1000000000ull / mcu->rate_hz;
+    uint64_t next_ns = monotonic_now_ns() + period_ns;
+    PoolEntry last;
+    int have_last = 0;
+
+    while (mcu->running)
+    {
+        /* --- 1. Sleep until the tick deadline. --- */
+        struct timespec deadline;
+        ns_to_timespec(next_ns, &deadline);
+
+        int rc = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &deadline, NULL);
+        if (rc == EINTR)
+            continue; /* interrupted — same deadline */
+        if (rc != 0)
+        {
+            /* Bad deadline; cannot recover.  Shows in the tick stats. */
+            stat_add(&mcu->tick_stats.errors, 1);
+            break;
+        }
+        if (!mcu->running)
+            break;
+
+        uint64_t now_ns = monotonic_now_ns();
+        lat_hist_record(&mcu->tick_jitter, (now_ns > next_ns) ? now_ns - next_ns : 0u);
+        stat_add(&mcu->tick_stats.ticks, 1);
+
+        /* --- 2. Send the best fresh command, else the watchdog stop
+         *        once the source has gone silent, else repeat the last
+         *        command until it expires.                           --- */
+        PoolEntry cmd;
+        if (pool_try_pop_best(mcu->pool, &cmd) == 0)
+        {
+            if (forward_batch(mcu, &cmd, 1) == 0)
+                stat_add(&mcu->tick_stats.sent_fresh, 1);
+            if (mcu->watchdog_ns != 0)
+                watchdog_feed(mcu, cmd.recv_ns);
+            last = cmd;
+            have_last = 1;
+        }
+        else if (watchdog_poll(mcu, now_ns))
+        {
+            have_last = 0; /* never resume a command from before the stop */
+        }
+        else if (have_last && (last.valid_until_ns == POOL_NO_DEADLINE ||
+                               now_ns <= last.valid_until_ns))
+        {
+            if (send_batch(mcu, &last, 1, NULL) == 1)
+                stat_add(&mcu->tick_stats.resent, 1);
+        }
+        else
+        {
+            have_last = 0;
+            stat_add(&mcu->tick_stats.idle, 1);
+        }
+
+        if (mcu->ack_timeout_ns != 0)
+            ack_drain(mcu);
+
+        /* --- 3. Advance to the next deadline, skipping any that have
+         *        already passed.                                     --- */
+        next_ns += period_ns;
+        now_ns = monotonic_now_ns();
+        if (now_ns >= next_ns)
+        {
+            uint64_t missed = (now_ns - next_ns) / period_ns + 1u;
+            stat_add(&mcu->tick_stats.overruns, missed);
+            next_ns += missed * period_ns;
+        }
+    }
+}
+
+static void *mcu_thread(void *arg)
+{
+    MCULogic *mcu = (MCULogic *)arg;
+
+    rt_thread_enter_sched(RT_THREAD_MCU, &mcu->thread_sched);
+
+    /* Silence is counted from thread start until the first command. */
+    mcu->watchdog_due_ns = monotonic_now_ns() + mcu->watchdog_ns;
+    mcu->watchdog_tripped = 0;
+
+    if (mcu->rate_hz != 0)
+        run_fixed_rate(mcu);
+    else
+        run_event_driven(mcu);
 
-    mq_close(mqd);
     return NULL;
 }
 
@@ -104,64 +526,157 @@ static void *mcu_thread(void *arg)
  * Public API
  * ----------------------------------------------------------------------- */
 
+/* Open the connected socket of one target. */
+static int target_open(MCUTarget *t, int primary)
+{
+    const MCUTargetConfig *cfg = &t->cfg;
+
+    /* Open outbound UDP socket. */
+    t->sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (t->sock_fd < 0)
+    {
+        perror("mcu_init: socket");
+        return -1;
+    }
+
+    /* Connect it to the target, so sends carry no address and the kernel
+     * routes once per socket rather than once per datagram. */
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    if (!cfg->host || inet_pton(AF_INET, cfg->host, &addr.sin_addr) != 1)
+    {
+        fprintf(stderr, "mcu_init: %s: invalid host address '%s'\n",
+                cfg->name, cfg->host ? cfg->host : "(null)");
+        return -1;
+    }
+
+    if (connect(t->sock_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        fprintf(stderr, "mcu_init: %s: connect to %s:%u: %s\n",
+                cfg->name, cfg->host, (unsigned)cfg->port, strerror(errno));
+        return -1;
+    }
+
+    /* Mirrors must never hold up the primary. */
+    if (!primary)
+    {
+        int flags = fcntl(t->sock_fd, F_GETFL, 0);
+        if (flags < 0 || fcntl(t->sock_fd, F_SETFL, flags | O_NONBLOCK) < 0)
+        {
+            perror("mcu_init: fcntl");
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
 int mcu_init(MCULogic *mcu, CommandPool *pool,
-             const char *mcu_host, uint16_t mcu_port)
+             const MCUTargetConfig *targets, size_t count, DbLogRing *log)
 {
-    if (!mcu || !pool || !mcu_host)
+    if (!mcu || !pool || !targets)
         return -1;
 
     memset(mcu, 0, sizeof(*mcu));
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+        lat_hist_init(&mcu->latency[p]);
+    lat_hist_init(&mcu->tick_jitter);
+    lat_hist_init(&mcu->ack_rtt);
+    lat_hist_init(&mcu->watchdog_reaction);
     mcu->pool = pool;
+    mcu->log = log;
     mcu->running = 0;
-    mcu->sock_fd = -1;
+    mcu->thread_sched.priority = 0;
+    mcu->thread_sched.cpu = -1;
+    for (size_t t = 0; t < MCU_MAX_TARGETS; ++t)
+        mcu->targets[t].sock_fd = -1;
 
-    /* Open outbound UDP socket (connectionless). */
-    mcu->sock_fd = socket(AF_INET, SOCK_DGRAM, 0);
-    if (mcu->sock_fd < 0)
+    if (count == 0 || count > MCU_MAX_TARGETS)
     {
-        perror("mcu_init: socket");
+        fprintf(stderr, "mcu_init: %zu targets configured (1..%u supported)\n",
+                count, (unsigned)MCU_MAX_TARGETS);
         return -1;
     }
 
-    /* Pre-fill the destination address for sendto. */
-    memset(&mcu->mcu_addr, 0, sizeof(mcu->mcu_addr));
-    mcu->mcu_addr.sin_family = AF_INET;
-    mcu->mcu_addr.sin_port = htons(mcu_port);
+    for (size_t t = 0; t < count; ++t)
+    {
+        mcu->targets[t].cfg = targets[t];
+        lat_hist_init(&mcu->targets[t].send_latency);
+        mcu->target_count = t + 1;
+        if (target_open(&mcu->targets[t], t == 0) != 0)
+        {
+            mcu_destroy(mcu);
+            return -1;
+        }
+    }
 
-    if (inet_pton(AF_INET, mcu_host, &mcu->mcu_addr.sin_addr) != 1)
+    return 0;
+}
+
+void mcu_set_thread(MCULogic *mcu, const RtThreadSched *sched)
+{
+    if (mcu && sched)
+        mcu->thread_sched = *sched;
+}
+
+int mcu_set_rate(MCULogic *mcu, unsigned rate_hz)
+{
+    if (!mcu)
+        return -1;
+
+    if (rate_hz != 0 && (rate_hz < MCU_RATE_MIN_HZ || rate_hz > MCU_RATE_MAX_HZ))
     {
-        fprintf(stderr, "mcu_init: invalid host address '%s'\n", mcu_host);
-        close(mcu->sock_fd);
-        mcu->sock_fd = -1;
+        fprintf(stderr, "mcu_set_rate: %u Hz outside %u..%u Hz\n",
+                rate_hz, MCU_RATE_MIN_HZ, MCU_RATE_MAX_HZ);
         return -1;
     }
 
+    mcu->rate_hz = rate_hz;
+    return 0;
+}
+
+int mcu_set_ack(MCULogic *mcu, uint32_t timeout_ms)
+{
+    if (!mcu || mcu->target_count == 0)
+        return -1;
+
+    mcu->ack_timeout_ns = (uint64_t)timeout_ms * 1000000ull;
+    if (timeout_ms != 0 && rx_timestamp_enable(mcu->targets[0].sock_fd) < 0)
+        perror("mcu_set_ack: receive timestamps"); /* RTT falls back to drain time */
+    return 0;
+}
+
+int mcu_set_watchdog(MCULogic *mcu, uint32_t silence_ms,
+                     const uint8_t *stop_payload)
+{
+    if (!mcu || (silence_ms != 0 && !stop_payload))
+        return -1;
+
+    mcu->watchdog_ns = (uint64_t)silence_ms * 1000000ull;
+    memset(&mcu->stop_cmd, 0, sizeof(mcu->stop_cmd));
+    if (silence_ms != 0)
+        memcpy(mcu->stop_cmd.ackermann_bytes, stop_payload, ACKERMANN_PAYLOAD_SIZE);
+    mcu->stop_cmd.priority = (uint8_t)(POOL_PRIORITY_LEVELS - 1u);
+    mcu->stop_cmd.source = POOL_SOURCE_NONE;
+    mcu->stop_cmd.valid_until_ns = POOL_NO_DEADLINE;
     return 0;
 }
 
 int mcu_start(MCULogic *mcu)
 {
-    if (!mcu || mcu->sock_fd < 0)
+    if (!mcu || mcu->target_count == 0)
         return -1;
 
     mcu->running = 1;
 
-    pthread_attr_t attr;
-    pthread_attr_init(&attr);
-
     /* MCU logic thread runs at a higher real-time priority than the
      * interface thread so scheduling decisions are never delayed by
-     * incoming packet processing. */
-#ifdef __QNXNTO__
-    struct sched_param sp;
-    pthread_attr_setschedpolicy(&attr, SCHED_FIFO);
-    sp.sched_priority = 30; /* higher than interface (20) */
-    pthread_attr_setschedparam(&attr, &sp);
-    pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
-#endif
-
-    int rc = pthread_create(&mcu->thread, &attr, mcu_thread, mcu);
-    pthread_attr_destroy(&attr);
+     * incoming packet processing (see rt_thread.c), unless
+     * mcu_set_thread() chose otherwise. */
+    int rc = rt_thread_create_sched(&mcu->thread, RT_THREAD_MCU, &mcu->thread_sched,
+                                    mcu_thread, mcu);
 
     if (rc != 0)
     {
@@ -180,8 +695,8 @@ void mcu_stop(MCULogic *mcu)
 
     mcu->running = 0;
 
-    /* Wake the MCU thread if it is blocked in pool_pop_best. */
-    pthread_cond_signal(&mcu->pool->not_empty);
+    /* Wake the MCU thread if it is blocked in pool_pop_batch. */
+    pool_wake(mcu->pool);
 
     pthread_join(mcu->thread, NULL);
 }
@@ -191,9 +706,140 @@ void mcu_destroy(MCULogic *mcu)
     if (!mcu)
         return;
 
-    if (mcu->sock_fd >= 0)
+    for (size_t t = 0; t < mcu->target_count; ++t)
+    {
+        if (mcu->targets[t].sock_fd >= 0)
+        {
+            close(mcu->targets[t].sock_fd);
+            mcu->targets[t].sock_fd = -1;
+        }
+    }
+    mcu->target_count = 0;
+}
+
+void mcu_dump_latency(MCULogic *mcu, FILE *out)
+{
+    if (!mcu || !out)
+        return;
+
+    fprintf(out, "Receive-to-forward latency by priority:\n");
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
     {
-        close(mcu->sock_fd);
-        mcu->sock_fd = -1;
+        LatencyHist snap;
+        lat_hist_snapshot(&mcu->latency[p], &snap);
+        if (snap.count == 0)
+            continue;
+
+        char label[32];
+        snprintf(label, sizeof(label), "  priority %3zu", p);
+        lat_hist_print(out, label, &snap);
     }
+
+    fprintf(out, "Send call latency by target:\n");
+    for (size_t t = 0; t < mcu->target_count; ++t)
+    {
+        LatencyHist snap;
+        lat_hist_snapshot(&mcu->targets[t].send_latency, &snap);
+
+        char label[32];
+        snprintf(label, sizeof(label), "  %-8s", mcu->targets[t].cfg.name);
+        lat_hist_print(out, label, &snap);
+    }
+
+    if (mcu->rate_hz != 0)
+    {
+        MCUTickStats ts;
+        mcu_get_tick_stats(mcu, &ts);
+        fprintf(out, "Fixed-rate loop at %u Hz: ticks=%llu fresh=%llu resent=%llu "
+                     "idle=%llu overruns=%llu errors=%llu\n",
+                mcu->rate_hz,
+                (unsigned long long)ts.ticks, (unsigned long long)ts.sent_fresh,
+                (unsigned long long)ts.resent, (unsigned long long)ts.idle,
+                (unsigned long long)ts.overruns, (unsigned long long)ts.errors);
+
+        LatencyHist snap;
+        lat_hist_snapshot(&mcu->tick_jitter, &snap);
+        lat_hist_print(out, "  tick jitter", &snap);
+    }
+    else
+    {
+        uint64_t errors = stat_read(&mcu->tick_stats.errors);
+        if (errors != 0)
+            fprintf(out, "Event-driven loop: errors=%llu\n", (unsigned long long)errors);
+    }
+
+    if (mcu->ack_timeout_ns != 0)
+    {
+        MCUAckStats as;
+        mcu_get_ack_stats(mcu, &as);
+        fprintf(out, "Ack channel (timeout %llu ms): tagged=%llu acked=%llu missing=%llu "
+                     "unmatched=%llu\n",
+                (unsigned long long)(mcu->ack_timeout_ns / 1000000ull),
+                (unsigned long long)as.tagged, (unsigned long long)as.acked,
+                (unsigned long long)as.missing, (unsigned long long)as.unmatched);
+
+        LatencyHist snap;
+        lat_hist_snapshot(&mcu->ack_rtt, &snap);
+        lat_hist_print(out, "  ack RTT", &snap);
+    }
+
+    if (mcu->watchdog_ns != 0)
+    {
+        MCUWatchdogStats ws;
+        mcu_get_watchdog_stats(mcu, &ws);
+        fprintf(out, "Watchdog at %llu ms: trips=%llu stops_sent=%llu\n",
+                (unsigned long long)(mcu->watchdog_ns / 1000000ull),
+                (unsigned long long)ws.trips, (unsigned long long)ws.stops_sent);
+
+        LatencyHist snap;
+        lat_hist_snapshot(&mcu->watchdog_reaction, &snap);
+        if (snap.count != 0)
+            lat_hist_print(out, "  stop reaction", &snap);
+    }
+    fflush(out);
+}
+
+void mcu_get_tick_stats(MCULogic *mcu, MCUTickStats *out)
+{
+    if (!mcu || !out)
+        return;
+
+    out->ticks = stat_read(&mcu->tick_stats.ticks);
+    out->sent_fresh = stat_read(&mcu->tick_stats.sent_fresh);
+    out->resent = stat_read(&mcu->tick_stats.resent);
+    out->idle = stat_read(&mcu->tick_stats.idle);
+    out->overruns = stat_read(&mcu->tick_stats.overruns);
+    out->errors = stat_read(&mcu->tick_stats.errors);
+}
+
+int mcu_get_target_stats(MCULogic *mcu, size_t index, MCUTargetStats *out)
+{
+    if (!mcu || !out || index >= mcu->target_count)
+        return -1;
+
+    const MCUTargetStats *s = &mcu->targets[index].stats;
+    out->sent = stat_read(&s->sent);
+    out->dropped = stat_read(&s->dropped);
+    out->errors = stat_read(&s->errors);
+    return 0;
+}
+
+void mcu_get_ack_stats(MCULogic *mcu, MCUAckStats *out)
+{
+    if (!mcu || !out)
+        return;
+
+    out->tagged = stat_read(&mcu->ack_stats.tagged);
+    out->acked = stat_read(&mcu->ack_stats.acked);
+    out->missing = stat_read(&mcu->ack_stats.missing);
+    out->unmatched = stat_read(&mcu->ack_stats.unmatched);
+}
+
+void mcu_get_watchdog_stats(MCULogic *mcu, MCUWatchdogStats *out)
+{
+    if (!mcu || !out)
+        return;
+
+    out->trips = stat_read(&mcu->watchdog_stats.trips);
+    out->stops_sent = stat_read(&mcu->watchdog_stats.stops_sent);
 }
@@ -2,38 +2,203 @@
 #define MCU_LOGIC_H
 
 #include <stdint.h>
-#include <netinet/in.h>
+#include <stdio.h>
 #include "command_pool.h"
-
-#include "dbstruct.h"
-#include <mqueue.h>
-#include <fcntl.h>
+#include "latency_hist.h"
+#include "db_logger.h"
+#include "rt_thread.h"
 
 /* -----------------------------------------------------------------------
  * MCULogic
  *
  * Implements the priority-based scheduling loop:
  *
- *   1. Block on pool_pop_best() to obtain the highest-priority valid
- *      command.
- *   2. Begin "executing" the command (forwarding the raw Ackermann bytes
- *      to the motor control team via UDP).
- *   3. A command that has been forwarded is considered done.
+ *   1. Block on pool_pop_batch() to obtain up to MCU_BATCH_MAX ready
+ *      commands in priority order (stale commands are discarded by the
+ *      pool).
+ *   2. Begin "executing" the commands (forwarding the raw Ackermann bytes
+ *      to the motor control team via UDP, one sendmmsg per batch and
+ *      target).
+ *   3. A command that has been forwarded is considered done; the time
+ *      from its kernel receive timestamp to the send is recorded in a
+ *      per-priority latency histogram and a database record is queued on
+ *      the thread's DbLogRing.
+ *
+ * With a tick rate set (mcu_set_rate), the loop instead runs as a
+ * fixed-rate control loop: it sleeps to absolute CLOCK_MONOTONIC
+ * deadlines with clock_nanosleep(TIMER_ABSTIME) and on every tick sends
+ * exactly one command — the best fresh one in the pool, or else a re-send
+ * of the last command it sent, until that one expires.  Wake-up jitter
+ * and overruns are recorded so the loop's determinism can be measured.
+ *
+ * Every command goes to each configured target: the primary MCU first,
+ * then any mirrors (data logger, hardware-in-the-loop rig).  Each target
+ * has its own connected UDP socket and send counters.  Mirror sockets are
+ * non-blocking and are only written after the primary send has finished,
+ * so a slow or dead mirror loses its own datagrams but never delays the
+ * primary.
+ *
+ * An optional ack channel (mcu_set_ack) measures the full round trip to
+ * the motor controller: every forwarded datagram gets a 4-byte id
+ * appended after the payload, the controller echoes the id back to the
+ * sending socket once it has applied the command, and the thread matches
+ * acks against a window of outstanding ids.  Ack arrival times come from
+ * kernel receive stamps, so the RTT does not depend on when the thread
+ * gets round to reading them.  Ids not acked within the timeout are
+ * counted as missing.
+ *
+ * A silence watchdog (mcu_set_watchdog) guards against a dead command
+ * source: once no command has been received for the silence interval the
+ * thread forwards a preconfigured stop payload, and repeats it every
+ * interval while the silence lasts.  It needs no extra thread — the pool
+ * wait simply never sleeps past the watchdog deadline — and the delay
+ * from the deadline to the stop leaving the socket is recorded.
  *
- * Runs in its own POSIX thread with SCHED_FIFO priority on QNX.
+ * Runs in its own thread, started through rt_thread as the MCU role:
+ * SCHED_FIFO at priority 30 unless mcu_set_thread() overrides it.  The
+ * policy is always applied on QNX, and on Linux in hardened mode (--rt);
+ * if that fails with EPERM the thread runs under the default policy and
+ * a warning is printed.  In hardened mode the thread is also pinned to
+ * the CPU from its RtThreadSched or RtConfig, if one is set.
  * ----------------------------------------------------------------------- */
 
+/* Most commands forwarded per pool pass / sendmmsg call. */
+#define MCU_BATCH_MAX 16u
+
+/* Most forwarding targets (primary + mirrors). */
+#define MCU_MAX_TARGETS 4u
+
+/* One entry of the target table handed to mcu_init(); entry 0 is the
+ * primary motor controller, the rest are mirrors. */
+typedef struct {
+    const char         *name;           /* label used in logs and stats     */
+    const char         *host;           /* IPv4 address                     */
+    uint16_t            port;           /* UDP port                         */
+} MCUTargetConfig;
+
+/* Per-target counters; read a snapshot with mcu_get_target_stats(). */
+typedef struct {
+    uint64_t            sent;           /* datagrams handed to the kernel   */
+    uint64_t            dropped;        /* datagrams not sent: full mirror socket or error */
+    uint64_t            errors;         /* failed send calls, incl. ICMP refused,
+                                           and failed ack receives (primary) */
+} MCUTargetStats;
+
+typedef struct {
+    MCUTargetConfig     cfg;
+    int                 sock_fd;        /* connected UDP socket             */
+    MCUTargetStats      stats;          /* written by the scheduling thread */
+    LatencyHist         send_latency;   /* duration of each send call       */
+} MCUTarget;
+
+/* Ack channel: a big-endian uint32 id appended to every forwarded
+ * payload when acks are on; an ack datagram starts with the same id. */
+#define MCU_ACK_TAG_SIZE 4u
+
+/* Outstanding ids tracked for ack matching.  Must be a power of two; an
+ * id still unacked when its slot is reused counts as missing. */
+#define MCU_ACK_WINDOW 256u
+
+/* Ack channel counters; read a snapshot with mcu_get_ack_stats(). */
+typedef struct {
+    uint64_t            tagged;         /* ids sent to the primary          */
+    uint64_t            acked;          /* ids acked within the timeout     */
+    uint64_t            missing;        /* ids never acked in time          */
+    uint64_t            unmatched;      /* late, duplicate or unknown acks  */
+} MCUAckStats;
+
+/* One outstanding id. */
+typedef struct {
+    uint32_t            id;
+    uint32_t            pending;        /* sent, not yet acked or expired   */
+    uint64_t            send_ns;        /* CLOCK_MONOTONIC, before the send */
+} MCUAckSlot;
+
+/* Accepted range for the fixed-rate mode; 0 selects event-driven mode. */
+#define MCU_RATE_MIN_HZ 1u
+#define MCU_RATE_MAX_HZ 1000u
+
+/* Fixed-rate loop counters; read a snapshot with mcu_get_tick_stats(). */
+typedef struct {
+    uint64_t            ticks;          /* deadlines serviced               */
+    uint64_t            sent_fresh;     /* ticks that sent a newly popped command */
+    uint64_t            resent;         /* ticks that re-sent the last command */
+    uint64_t            idle;           /* ticks with nothing valid to send */
+    uint64_t            overruns;       /* deadlines skipped: loop fell behind */
+    uint64_t            errors;         /* failed pool waits or tick sleeps,
+                                           in either mode */
+} MCUTickStats;
+
+/* Silence watchdog counters; read a snapshot with mcu_get_watchdog_stats(). */
+typedef struct {
+    uint64_t            trips;          /* silences that reached the interval */
+    uint64_t            stops_sent;     /* stop payloads sent, repeats included */
+} MCUWatchdogStats;
+
 typedef struct {
     CommandPool        *pool;           /* shared pool — NOT owned here     */
-    int                 sock_fd;        /* UDP socket for outbound traffic   */
-    struct sockaddr_in  mcu_addr;       /* motor-control team destination    */
+    MCUTarget           targets[MCU_MAX_TARGETS]; /* [0] is the primary */
+    size_t              target_count;
+    DbLogRing          *log;            /* forward log ring, NULL = none     */
     pthread_t           thread;
+    RtThreadSched       thread_sched;   /* thread priority and CPU          */
     volatile int        running;
+
+    /* Receive (kernel RX timestamp) to forward latency, per priority.
+     * Written only by the scheduling thread. */
+    LatencyHist         latency[POOL_PRIORITY_LEVELS];
+
+    /* Fixed-rate mode — rate_hz 0 means event-driven. */
+    unsigned            rate_hz;
+    MCUTickStats        tick_stats;     /* written by the scheduling thread */
+    LatencyHist         tick_jitter;    /* wake-up time minus deadline      */
+
+    /* Ack channel — ack_timeout_ns 0 means disabled.  All but the stats
+     * are private to the scheduling thread. */
+    uint64_t            ack_timeout_ns;
+    uint32_t            ack_next_id;    /* id of the next datagram sent     */
+    uint32_t            ack_oldest_id;  /* oldest id that may be pending    */
+    MCUAckSlot          ack_window[MCU_ACK_WINDOW];
+    MCUAckStats         ack_stats;      /* written by the scheduling thread */
+    LatencyHist         ack_rtt;        /* send to ack kernel receive time  */
+
+    /* Silence watchdog — watchdog_ns 0 means disabled. */
+    uint64_t            watchdog_ns;
+    PoolEntry           stop_cmd;       /* payload sent when it trips       */
+    uint64_t            watchdog_due_ns; /* scheduling thread only          */
+    int                 watchdog_tripped; /* scheduling thread only         */
+    MCUWatchdogStats    watchdog_stats; /* written by the scheduling thread */
+    LatencyHist         watchdog_reaction; /* stop send time minus deadline */
 } MCULogic;
 
-/* Initialise (opens outbound UDP socket, does NOT start thread). */
+/* Initialise (opens one connected UDP socket per target, does NOT start
+ * thread).  targets[0] is the primary; count is 1..MCU_MAX_TARGETS.
+ * Forwarded commands are logged to log (may be NULL). */
 int  mcu_init(MCULogic *mcu, CommandPool *pool,
-              const char *mcu_host, uint16_t mcu_port);
+              const MCUTargetConfig *targets, size_t count, DbLogRing *log);
+
+/* Override the scheduling thread's priority and CPU (see RtThreadSched).
+ * Call before mcu_start(). */
+void mcu_set_thread(MCULogic *mcu, const RtThreadSched *sched);
+
+/* Select fixed-rate mode at rate_hz ticks per second, or event-driven
+ * mode with 0.  Call before mcu_start().  Returns 0, or -1 if rate_hz is
+ * outside MCU_RATE_MIN_HZ..MCU_RATE_MAX_HZ. */
+int  mcu_set_rate(MCULogic *mcu, unsigned rate_hz);
+
+/* Turn on the ack channel: tag every forwarded datagram with an id and
+ * expect an ack for it from the primary target within timeout_ms.
+ * timeout_ms 0 leaves datagrams untagged.  Mirrors receive the same
+ * tagged datagrams but their acks are not read.  Call after mcu_init()
+ * and before mcu_start(). */
+int  mcu_set_ack(MCULogic *mcu, uint32_t timeout_ms);
+
+/* Arm the silence watchdog: after silence_ms without a received command,
+ * forward stop_payload (ACKERMANN_PAYLOAD_SIZE bytes), repeating it every
+ * silence_ms until commands resume.  silence_ms 0 disables it.  Call
+ * before mcu_start(). */
+int  mcu_set_watchdog(MCULogic *mcu, uint32_t silence_ms,
+                      const uint8_t *stop_payload);
 
 /* Start the scheduling thread. */
 int  mcu_start(MCULogic *mcu);
@@ -44,7 +209,25 @@ void mcu_stop(MCULogic *mcu);
 /* Release all resources. */
 void mcu_destroy(MCULogic *mcu);
 
-//Message queue struct
-extern mqd_t mqd;
+/* Print the receive-to-forward latency histogram of every priority that
+ * has seen traffic, and the send-call latency of every target.  In
+ * fixed-rate mode, also print the tick counters and jitter histogram.
+ * With acks on, add the RTT histogram and ack counters; with the
+ * watchdog armed, its counters and reaction histogram.  Safe to call
+ * while the thread runs. */
+void mcu_dump_latency(MCULogic *mcu, FILE *out);
+
+/* Copy the fixed-rate loop counters into *out.  Safe from any thread. */
+void mcu_get_tick_stats(MCULogic *mcu, MCUTickStats *out);
+
+/* Copy the counters of target index into *out.  Safe from any thread.
+ * Returns 0, or -1 if index is out of range. */
+int  mcu_get_target_stats(MCULogic *mcu, size_t index, MCUTargetStats *out);
+
+/* Copy the ack channel counters into *out.  Safe from any thread. */
+void mcu_get_ack_stats(MCULogic *mcu, MCUAckStats *out);
+
+/* Copy the watchdog counters into *out.  Safe from any thread. */
+void mcu_get_watchdog_stats(MCULogic *mcu, MCUWatchdogStats *out);
 
 #endif /* MCU_LOGIC_H */
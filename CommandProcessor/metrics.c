@@ -0,0 +1,202 @@
+#include "metrics.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+_Static_assert(METRICS_MAX_CHANNELS >= CHANNEL_MAX, "metrics: channel table too small");
+_Static_assert(METRICS_MAX_SOURCES >= INTERFACE_MAX_SOURCES, "metrics: source table too small");
+_Static_assert(METRICS_MAX_TARGETS >= MCU_MAX_TARGETS, "metrics: target table too small");
+
+/* Add the snapshot h to into. */
+static void hist_merge(LatencyHist *into, const LatencyHist *h)
+{
+    if (h->count == 0)
+        return;
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+        into->buckets[b] += h->buckets[b];
+    if (h->min_ns < into->min_ns)
+        into->min_ns = h->min_ns;
+    if (h->max_ns > into->max_ns)
+        into->max_ns = h->max_ns;
+    into->count += h->count;
+    into->sum_ns += h->sum_ns;
+}
+
+int metrics_open(MetricsPublisher *m)
+{
+    if (!m)
+        return -1;
+
+    m->page = NULL;
+    m->staging = calloc(1, sizeof(MetricsPage));
+    if (!m->staging)
+    {
+        perror("metrics_open: calloc");
+        return -1;
+    }
+
+    int fd = shm_open(METRICS_SHM_NAME, O_CREAT | O_RDWR, 0644);
+    if (fd < 0)
+    {
+        perror("metrics_open: shm_open");
+        metrics_close(m);
+        return -1;
+    }
+
+    if (ftruncate(fd, sizeof(MetricsPage)) < 0)
+    {
+        perror("metrics_open: ftruncate");
+        close(fd);
+        metrics_close(m);
+        return -1;
+    }
+
+    void *addr = mmap(NULL, sizeof(MetricsPage), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd); /* the mapping keeps the object alive */
+    if (addr == MAP_FAILED)
+    {
+        perror("metrics_open: mmap");
+        metrics_close(m);
+        return -1;
+    }
+    m->page = (MetricsPage *)addr;
+
+    /* A page left by an earlier run keeps its content until the first
+     * publish; invalidate it so readers do not trust it meanwhile. */
+    __atomic_store_n(&m->page->magic, 0u, __ATOMIC_RELAXED);
+
+    MetricsPage *st = m->staging;
+    st->magic = METRICS_MAGIC;
+    st->version = METRICS_VERSION;
+    st->size = sizeof(MetricsPage);
+    st->pid = (uint32_t)getpid();
+    st->publish_interval_ms = (uint32_t)METRICS_PUBLISH_MS;
+    return 0;
+}
+
+void metrics_publish(MetricsPublisher *m, Channel *channels, size_t count)
+{
+    if (!m || !m->page)
+        return;
+
+    MetricsPage *st = m->staging;
+
+    /* --- Assemble the snapshot off the shared page. --- */
+    st->received = 0;
+    st->throttled = 0;
+    st->dropped = 0;
+    st->expired = 0;
+    st->forwarded = 0;
+    st->pool_depth = 0;
+    st->pool_depth_hwm = 0;
+    st->pool_pushed = 0;
+    st->pool_popped = 0;
+    st->pool_ingress_full = 0;
+    st->pool_dropped_full = 0;
+    st->pool_evicted = 0;
+    st->pool_coalesced = 0;
+    st->channel_count = 0;
+    st->source_count = 0;
+    st->target_count = 0;
+    for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+        lat_hist_init(&st->latency[p]);
+
+    for (size_t c = 0; c < count && c < METRICS_MAX_CHANNELS; ++c)
+    {
+        Channel *ch = &channels[c];
+
+        /* Per-channel counters, as the DB log summary sees them. */
+        ChannelStats cs;
+        channel_get_stats(ch, &cs);
+
+        MetricsChannel *mc = &st->channels[st->channel_count++];
+        memset(mc, 0, sizeof(*mc));
+        strncpy(mc->name, ch->cfg.name, sizeof(mc->name) - 1u);
+        mc->received = cs.received;
+        mc->throttled = cs.throttled;
+        mc->dropped = cs.dropped;
+        mc->expired = cs.expired;
+        mc->forwarded = cs.forwarded;
+        mc->depth = cs.depth;
+        mc->depth_hwm = cs.depth_hwm;
+
+        st->received += cs.received;
+        st->throttled += cs.throttled;
+        st->dropped += cs.dropped;
+        st->expired += cs.expired;
+        st->forwarded += cs.forwarded;
+        st->pool_depth += cs.depth;
+        if (cs.depth_hwm > st->pool_depth_hwm)
+            st->pool_depth_hwm = cs.depth_hwm;
+
+        /* Pool counters ChannelStats does not break out. */
+        PoolStats ps;
+        pool_get_stats(&ch->pool, &ps);
+        st->pool_pushed += ps.pushed;
+        st->pool_popped += ps.popped;
+        st->pool_ingress_full += ps.ingress_full;
+        st->pool_dropped_full += ps.dropped_full;
+        st->pool_evicted += ps.evicted;
+        st->pool_coalesced += ps.coalesced;
+
+        for (size_t i = 0; i < ch->iface.source_count && st->source_count < METRICS_MAX_SOURCES; ++i)
+        {
+            InterfaceSourceStats ss;
+            interface_get_source_stats(&ch->iface, i, &ss);
+            MetricsSource *ms = &st->sources[st->source_count++];
+            strncpy(ms->name, ch->iface.sources[i].cfg.name, sizeof(ms->name) - 1u);
+            ms->received = ss.received;
+            ms->malformed = ss.malformed;
+            ms->throttled = ss.throttled;
+            ms->pushed = ss.pushed;
+            ms->dropped = ss.dropped;
+        }
+
+        for (size_t t = 0; t < ch->mcu.target_count && st->target_count < METRICS_MAX_TARGETS; ++t)
+        {
+            MCUTargetStats ts;
+            mcu_get_target_stats(&ch->mcu, t, &ts);
+            MetricsTarget *mt = &st->targets[st->target_count++];
+            strncpy(mt->name, ch->mcu.targets[t].cfg.name, sizeof(mt->name) - 1u);
+            mt->sent = ts.sent;
+            mt->dropped = ts.dropped;
+            mt->errors = ts.errors;
+        }
+
+        for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+        {
+            LatencyHist snap;
+            lat_hist_snapshot(&ch->mcu.latency[p], &snap);
+            hist_merge(&st->latency[p], &snap);
+        }
+    }
+
+    st->publish_ns = monotonic_now_ns();
+    st->publish_count++;
+
+    /* --- Seqlock write: odd, copy, even. --- */
+    uint32_t seq = m->page->seq;
+    st->seq = seq + 1u;
+    __atomic_store_n(&m->page->seq, seq + 1u, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    memcpy(m->page, st, sizeof(*st));
+    __atomic_store_n(&m->page->seq, seq + 2u, __ATOMIC_RELEASE);
+}
+
+void metrics_close(MetricsPublisher *m)
+{
+    if (!m)
+        return;
+
+    if (m->page)
+    {
+        munmap(m->page, sizeof(MetricsPage));
+        m->page = NULL;
+        shm_unlink(METRICS_SHM_NAME);
+    }
+    free(m->staging);
+    m->staging = NULL;
+}
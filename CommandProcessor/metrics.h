@@ -0,0 +1,172 @@
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include <string.h>
+
+#include "channel.h"
+#include "command_pool.h"
+#include "latency_hist.h"
+
+/* -----------------------------------------------------------------------
+ * Metrics page — live counters in POSIX shared memory.
+ *
+ * The main thread, which otherwise only waits for a signal, copies a
+ * snapshot of every counter into one MetricsPage every
+ * METRICS_PUBLISH_MS.  The real-time threads are not involved: the
+ * snapshot reads the same relaxed single-writer counters used for the
+ * shutdown report, so publishing adds no work and no lock to the hot
+ * path.
+ *
+ * The page is a seqlock: the publisher makes seq odd, writes, then makes
+ * it even again.  A reader (cp_stat, or anything that maps
+ * METRICS_SHM_NAME read-only) copies the page and retries while seq is
+ * odd or changed during the copy, so it never blocks the publisher and
+ * never sees a torn snapshot.  Readers must check magic, version and
+ * size before trusting the layout.
+ * ----------------------------------------------------------------------- */
+
+#define METRICS_SHM_NAME "/cp_metrics"
+#define METRICS_MAGIC 0x544D5043u /* "CPMT" */
+#define METRICS_VERSION 3u
+
+/* Publish interval — also the finest useful sampling interval. */
+#define METRICS_PUBLISH_MS 100L
+
+/* Fixed table sizes, so the layout does not depend on other headers. */
+#define METRICS_MAX_CHANNELS 4u
+#define METRICS_MAX_SOURCES 16u
+#define METRICS_MAX_TARGETS 8u
+#define METRICS_NAME_LEN 16u
+
+typedef struct
+{
+    char name[METRICS_NAME_LEN];
+    uint64_t received;
+    uint64_t throttled;
+    uint64_t dropped;
+    uint64_t expired;
+    uint64_t forwarded;
+    uint64_t depth;
+    uint64_t depth_hwm;
+} MetricsChannel;
+
+typedef struct
+{
+    char name[METRICS_NAME_LEN];
+    uint64_t received;
+    uint64_t malformed;
+    uint64_t throttled;
+    uint64_t pushed;
+    uint64_t dropped;
+} MetricsSource;
+
+typedef struct
+{
+    char name[METRICS_NAME_LEN];
+    uint64_t sent;
+    uint64_t dropped;
+    uint64_t errors;
+} MetricsTarget;
+
+typedef struct
+{
+    /* --- Header ------------------------------------------------------ */
+    uint32_t magic;         /* METRICS_MAGIC                            */
+    uint32_t version;       /* METRICS_VERSION                          */
+    uint32_t size;          /* sizeof(MetricsPage)                      */
+    uint32_t seq;           /* seqlock: odd while being written         */
+    uint32_t pid;           /* publishing process                       */
+    uint32_t publish_interval_ms;
+    uint64_t publish_ns;    /* CLOCK_MONOTONIC of this snapshot         */
+    uint64_t publish_count;
+
+    /* --- Totals, all channels ---------------------------------------- */
+    uint64_t received;      /* datagrams read, all sources              */
+    uint64_t dropped;       /* valid commands lost: no slot, ring full,
+                               pool full or evicted                     */
+    uint64_t throttled;     /* dropped by a source's rate limit         */
+    uint64_t expired;       /* discarded past their deadline            */
+    uint64_t forwarded;     /* sent to a primary target                 */
+
+    /* --- Pools, summed over channels --------------------------------- */
+    uint64_t pool_depth;
+    uint64_t pool_depth_hwm; /* deepest single pool                     */
+    uint64_t pool_pushed;
+    uint64_t pool_popped;
+    uint64_t pool_ingress_full;
+    uint64_t pool_dropped_full;
+    uint64_t pool_evicted;
+    uint64_t pool_coalesced;
+
+    /* --- Per channel / source / target, in channel order ------------- */
+    uint32_t channel_count;
+    uint32_t source_count;
+    uint32_t target_count;
+    MetricsChannel channels[METRICS_MAX_CHANNELS];
+    MetricsSource sources[METRICS_MAX_SOURCES];
+    MetricsTarget targets[METRICS_MAX_TARGETS];
+
+    /* --- Receive-to-forward latency, per priority, all channels ------ */
+    LatencyHist latency[POOL_PRIORITY_LEVELS];
+} MetricsPage;
+
+/* How long metrics_read() retries before giving up on the publisher.  A
+ * publish is one page copy; seq still odd after this means the process
+ * died or was stopped mid-write. */
+#define METRICS_READ_TIMEOUT_MS 1000L
+
+/* Copy a consistent snapshot of *page into *out.  Lock-free; retries
+ * while the publisher is mid-write, for at most METRICS_READ_TIMEOUT_MS.
+ * Returns 0, -1 if the page is not a MetricsPage of this version, or -2
+ * if the publisher stalled mid-write. */
+static inline int metrics_read(const MetricsPage *page, MetricsPage *out)
+{
+    const uint64_t deadline_ns =
+        monotonic_now_ns() + (uint64_t)METRICS_READ_TIMEOUT_MS * 1000000ull;
+
+    for (;;)
+    {
+        uint32_t s1 = __atomic_load_n(&page->seq, __ATOMIC_ACQUIRE);
+        if (s1 & 1u)
+        {
+            if (monotonic_now_ns() >= deadline_ns)
+                return -2;
+            continue; /* publisher mid-write */
+        }
+
+        memcpy(out, page, sizeof(*out));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&page->seq, __ATOMIC_RELAXED) == s1)
+            break;
+    }
+
+    if (out->magic != METRICS_MAGIC || out->version != METRICS_VERSION ||
+        out->size != sizeof(MetricsPage))
+        return -1;
+    return 0;
+}
+
+/* -----------------------------------------------------------------------
+ * Publisher (the command processor's main thread)
+ * ----------------------------------------------------------------------- */
+
+typedef struct
+{
+    MetricsPage *page;    /* shared mapping                          */
+    MetricsPage *staging; /* snapshot assembled outside the seqlock  */
+} MetricsPublisher;
+
+/* Create (or take over) METRICS_SHM_NAME and map it.  Returns 0 or -1. */
+int metrics_open(MetricsPublisher *m);
+
+/* Snapshot every counter of channels[0..count) into the page.  Sources
+ * and targets beyond the page's tables are left out of the per-source
+ * and per-target lists, but not out of the totals.  Publisher thread
+ * only. */
+void metrics_publish(MetricsPublisher *m, Channel *channels, size_t count);
+
+/* Unmap and remove the page. */
+void metrics_close(MetricsPublisher *m);
+
+#endif /* METRICS_H */
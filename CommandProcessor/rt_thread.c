@@ -0,0 +1,135 @@
+#define _GNU_SOURCE /* pthread_setaffinity_np on glibc */
+#include "rt_thread.h"
+
+#include <errno.h>
+#include <sched.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#ifdef __QNXNTO__
+#include <sys/neutrino.h>
+#endif
+
+/* Scheduling per role.  The MCU thread outranks the interface thread so
+ * scheduling decisions are never delayed by incoming packet processing;
+ * the logger runs below both so logging never competes with commands. */
+static const struct
+{
+    const char *name;
+    int policy;
+    int priority;
+} g_roles[RT_THREAD_ROLES] = {
+    [RT_THREAD_INTERFACE] = {"interface", SCHED_FIFO, 20},
+    [RT_THREAD_MCU] = {"mcu", SCHED_FIFO, 30},
+    [RT_THREAD_DBLOG] = {"dblog", SCHED_RR, 10},
+};
+
+/* Written once by rt_configure() before any thread starts. */
+static RtConfig g_config = {0, {-1, -1, -1}};
+
+int rt_configure(const RtConfig *cfg)
+{
+    if (!cfg)
+        return -1;
+
+    g_config = *cfg;
+    if (!g_config.harden)
+        return 0;
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+    {
+        perror("rt_configure: mlockall");
+        return -1;
+    }
+    return 0;
+}
+
+int rt_thread_create(pthread_t *thread, RtThreadRole role,
+                     void *(*start)(void *), void *arg)
+{
+    return rt_thread_create_sched(thread, role, NULL, start, arg);
+}
+
+int rt_thread_create_sched(pthread_t *thread, RtThreadRole role, const RtThreadSched *sched,
+                           void *(*start)(void *), void *arg)
+{
+    int priority = (sched && sched->priority > 0) ? sched->priority : g_roles[role].priority;
+
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+
+    int explicit_sched = 0;
+#ifdef __QNXNTO__
+    explicit_sched = 1;
+#endif
+    if (g_config.harden)
+    {
+        explicit_sched = 1;
+        pthread_attr_setstacksize(&attr, RT_STACK_SIZE);
+    }
+
+    if (explicit_sched)
+    {
+        struct sched_param sp;
+        memset(&sp, 0, sizeof(sp));
+        sp.sched_priority = priority;
+        pthread_attr_setschedpolicy(&attr, g_roles[role].policy);
+        pthread_attr_setschedparam(&attr, &sp);
+        pthread_attr_setinheritsched(&attr, PTHREAD_EXPLICIT_SCHED);
+    }
+
+    int rc = pthread_create(thread, &attr, start, arg);
+    if (rc == EPERM && explicit_sched)
+    {
+        /* Not allowed to use real-time policies (unprivileged Linux). */
+        fprintf(stderr, "rt_thread_create: %s: no permission for real-time "
+                        "priority %d, using the default policy\n",
+                g_roles[role].name, priority);
+        pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+        rc = pthread_create(thread, &attr, start, arg);
+    }
+    pthread_attr_destroy(&attr);
+    return rc;
+}
+
+/* Touch RT_STACK_PREFAULT bytes below the caller's frame, one write per
+ * page.  Kept out of line so the buffer really lives on this stack. */
+static __attribute__((noinline)) void prefault_stack(void)
+{
+    volatile uint8_t buf[RT_STACK_PREFAULT];
+    for (size_t i = 0; i < sizeof(buf); i += 4096u)
+        buf[i] = 0;
+}
+
+void rt_thread_enter(RtThreadRole role)
+{
+    rt_thread_enter_sched(role, NULL);
+}
+
+void rt_thread_enter_sched(RtThreadRole role, const RtThreadSched *sched)
+{
+    if (!g_config.harden)
+        return;
+
+    int cpu = (sched && sched->cpu >= 0) ? sched->cpu : g_config.cpu[role];
+    if (cpu >= 0)
+    {
+#ifdef __QNXNTO__
+        if (ThreadCtl(_NTO_TCTL_RUNMASK, (void *)(uintptr_t)(1u << cpu)) == -1)
+            fprintf(stderr, "rt_thread_enter: %s: ThreadCtl(RUNMASK): %s\n",
+                    g_roles[role].name, strerror(errno));
+#elif defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        int rc = pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+        if (rc != 0)
+            fprintf(stderr, "rt_thread_enter: %s: pin to CPU %d: %s\n",
+                    g_roles[role].name, cpu, strerror(rc));
+#endif
+    }
+
+    prefault_stack();
+}
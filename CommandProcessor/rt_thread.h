@@ -0,0 +1,78 @@
+#ifndef RT_THREAD_H
+#define RT_THREAD_H
+
+#include <pthread.h>
+#include <stddef.h>
+
+/* -----------------------------------------------------------------------
+ * Real-time thread setup, shared by every thread the process starts.
+ *
+ * Each thread has a role that fixes its scheduling policy and default
+ * priority (see rt_thread.c).  On QNX the policy is always applied, as
+ * before.  A thread may override its role's priority and CPU with an
+ * RtThreadSched, so the threads of one channel can rank above or below
+ * those of another (see channel.h).
+ *
+ * Hardening (RtConfig.harden, chosen at run time) adds:
+ *   - mlockall(MCL_CURRENT | MCL_FUTURE), done by rt_configure() before
+ *     any thread starts, so the statically allocated pool, histograms
+ *     and log rings, and every thread stack, stay resident;
+ *   - the same SCHED_FIFO / SCHED_RR priorities on Linux (needs
+ *     CAP_SYS_NICE or an rtprio limit; without it the thread falls back
+ *     to the default policy with a warning);
+ *   - a fixed RT_STACK_SIZE stack per thread, whose first
+ *     RT_STACK_PREFAULT bytes are touched on entry so the hot path never
+ *     takes a stack page fault;
+ *   - optional pinning of each role to one CPU.
+ * ----------------------------------------------------------------------- */
+
+/* Stack size of each thread in hardened mode. */
+#define RT_STACK_SIZE (256u * 1024u)
+
+/* Stack bytes touched by rt_thread_enter() in hardened mode. */
+#define RT_STACK_PREFAULT (64u * 1024u)
+
+typedef enum
+{
+    RT_THREAD_INTERFACE, /* command receive                  */
+    RT_THREAD_MCU,       /* scheduling and forwarding        */
+    RT_THREAD_DBLOG,     /* database logging (best effort)   */
+    RT_THREAD_ROLES
+} RtThreadRole;
+
+typedef struct
+{
+    int harden;               /* 0 = plain threads, 1 = hardened mode    */
+    int cpu[RT_THREAD_ROLES]; /* CPU to pin each role to, -1 = any       */
+} RtConfig;
+
+/* Per-thread overrides of the role defaults. */
+typedef struct
+{
+    int priority; /* scheduling priority, 0 = the role's default      */
+    int cpu;      /* CPU to pin to, -1 = the role's CPU from RtConfig  */
+} RtThreadSched;
+
+/* Select the process-wide mode.  Call once from main() before any thread
+ * is started.  In hardened mode locks all memory; returns -1 if that
+ * fails (the caller may carry on unlocked), else 0. */
+int rt_configure(const RtConfig *cfg);
+
+/* pthread_create with the role's scheduling (and in hardened mode its
+ * stack size).  Returns 0 or the pthread_create error. */
+int rt_thread_create(pthread_t *thread, RtThreadRole role,
+                     void *(*start)(void *), void *arg);
+
+/* rt_thread_create() with the priority from sched (may be NULL). */
+int rt_thread_create_sched(pthread_t *thread, RtThreadRole role, const RtThreadSched *sched,
+                           void *(*start)(void *), void *arg);
+
+/* First call in every thread function: in hardened mode pins the thread
+ * to its role's CPU and prefaults its stack.  No-op otherwise. */
+void rt_thread_enter(RtThreadRole role);
+
+/* rt_thread_enter() with the CPU from sched (may be NULL).  Pass the same
+ * sched as to rt_thread_create_sched(). */
+void rt_thread_enter_sched(RtThreadRole role, const RtThreadSched *sched);
+
+#endif /* RT_THREAD_H */
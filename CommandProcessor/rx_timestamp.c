@@ -0,0 +1,68 @@
+#include "rx_timestamp.h"
+
+#include <string.h>
+#include <sys/time.h>
+
+static inline uint64_t ts_to_ns(const struct timespec *ts)
+{
+    return (uint64_t)ts->tv_sec * 1000000000ull + (uint64_t)ts->tv_nsec;
+}
+
+int rx_timestamp_enable(int fd)
+{
+    int on = 1;
+#if defined(SO_TIMESTAMPNS)
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on));
+#elif defined(SO_TIMESTAMP)
+    return setsockopt(fd, SOL_SOCKET, SO_TIMESTAMP, &on, sizeof(on));
+#else
+    (void)fd;
+    (void)on;
+    return -1;
+#endif
+}
+
+int64_t rx_real_to_mono_ns(uint64_t *mono_now_ns)
+{
+    struct timespec mono_now, real_now;
+    clock_gettime(CLOCK_MONOTONIC, &mono_now);
+    clock_gettime(CLOCK_REALTIME, &real_now);
+    *mono_now_ns = ts_to_ns(&mono_now);
+    return (int64_t)*mono_now_ns - (int64_t)ts_to_ns(&real_now);
+}
+
+uint64_t rx_timestamp_ns(struct msghdr *hdr, int64_t real_to_mono_ns,
+                         uint64_t fallback_ns)
+{
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(hdr); c != NULL; c = CMSG_NXTHDR(hdr, c))
+    {
+        if (c->cmsg_level != SOL_SOCKET)
+            continue;
+
+        int64_t real_ns = -1;
+#ifdef SCM_TIMESTAMPNS
+        if (c->cmsg_type == SCM_TIMESTAMPNS)
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            real_ns = (int64_t)ts_to_ns(&ts);
+        }
+#endif
+#ifdef SCM_TIMESTAMP
+        if (c->cmsg_type == SCM_TIMESTAMP)
+        {
+            struct timeval tv;
+            memcpy(&tv, CMSG_DATA(c), sizeof(tv));
+            real_ns = (int64_t)tv.tv_sec * 1000000000LL + (int64_t)tv.tv_usec * 1000LL;
+        }
+#endif
+        if (real_ns >= 0)
+        {
+            int64_t mono_ns = real_ns + real_to_mono_ns;
+            if (mono_ns > 0 && (uint64_t)mono_ns < fallback_ns)
+                return (uint64_t)mono_ns;
+            return fallback_ns;
+        }
+    }
+    return fallback_ns;
+}
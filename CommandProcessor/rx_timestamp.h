@@ -0,0 +1,40 @@
+#ifndef RX_TIMESTAMP_H
+#define RX_TIMESTAMP_H
+
+#include <stdint.h>
+#include <time.h>
+#include <sys/socket.h>
+
+/* -----------------------------------------------------------------------
+ * Kernel receive timestamps
+ *
+ * A socket opened with rx_timestamp_enable() gets SO_TIMESTAMPNS
+ * (SO_TIMESTAMP where only that exists), so every datagram carries the
+ * time the kernel queued it, which includes any socket queueing delay
+ * hidden from a clock read after recv.  Those stamps are CLOCK_REALTIME;
+ * they are moved onto CLOCK_MONOTONIC with an offset sampled once per
+ * batch by rx_real_to_mono_ns().
+ * ----------------------------------------------------------------------- */
+
+/* Control buffer large enough for one timestamp cmsg. */
+typedef union
+{
+    char buf[CMSG_SPACE(sizeof(struct timespec))];
+    struct cmsghdr align;
+} RxControl;
+
+/* Ask the kernel to stamp every datagram received on fd.  Returns 0, or
+ * -1 with errno set; callers treat failure as non-fatal. */
+int rx_timestamp_enable(int fd);
+
+/* Sample CLOCK_MONOTONIC into *mono_now_ns and return the offset that
+ * moves a CLOCK_REALTIME time onto CLOCK_MONOTONIC. */
+int64_t rx_real_to_mono_ns(uint64_t *mono_now_ns);
+
+/* Receive time of a datagram on CLOCK_MONOTONIC.  Uses the kernel stamp
+ * when present (shifted by real_to_mono_ns), else fallback_ns.  Never
+ * returns a time later than fallback_ns, which is "now". */
+uint64_t rx_timestamp_ns(struct msghdr *hdr, int64_t real_to_mono_ns,
+                         uint64_t fallback_ns);
+
+#endif /* RX_TIMESTAMP_H */
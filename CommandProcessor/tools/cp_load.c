@@ -0,0 +1,422 @@
+/* -----------------------------------------------------------------------
+ * cp_load — high-rate load generator for the command processor.
+ *
+ * Sends version 2 command packets whose payload is a probe (probe.h), so
+ * cp_sink can match every forwarded command back to its send.  One
+ * unconnected socket serves every destination port, and each burst goes
+ * out in a single sendmmsg call, so rates of a few hundred thousand
+ * packets per second are reachable on one core.
+ *
+ *   -h HOST        processor address (default 127.0.0.1)
+ *   -p PORT[,..]   source ports; packets rotate over them (default 5000)
+ *   -r RATE        packets per second, 0 = as fast as possible (default 1000)
+ *   -n COUNT       stop after COUNT packets
+ *   -d SECONDS     stop after SECONDS (default 5, unless -n is given)
+ *   -b BURST       packets sent back to back per burst (default 1); the
+ *                  bursts are spaced to keep the average at RATE
+ *   -w ON/OFF      on/off pattern in ms: send at RATE for ON ms, then
+ *                  pause for OFF ms
+ *   -P DIST        priority distribution:
+ *                    N           always N
+ *                    LO-HI       uniform over LO..HI
+ *                    P:W,P:W..   priority P with relative weight W
+ *                  (default 0-255)
+ *   -f MS          freshness of every command (default 1000, 0 = never expires)
+ *   -s SEED        random seed (default: time)
+ *
+ * Bursts are paced on absolute CLOCK_MONOTONIC deadlines: the tool sleeps
+ * when the next burst is far away and spins when it is close, and a burst
+ * that is already late is sent at once so the average rate holds.  The
+ * summary reports how late bursts left.
+ *
+ * Usage:  cp_load [options]   (see above)
+ * ----------------------------------------------------------------------- */
+#define _GNU_SOURCE /* sendmmsg on glibc */
+#include "probe.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Batched transmit is available on Linux and QNX 7+; elsewhere fall back
+ * to one sendmsg per packet. */
+#if defined(__linux__) || defined(__QNXNTO__)
+#define LOAD_HAVE_SENDMMSG 1
+#endif
+
+/* Most packets handed to one sendmmsg call; larger bursts take several. */
+#define LOAD_BATCH_MAX 64u
+
+/* Most destination ports. */
+#define LOAD_MAX_PORTS 8u
+
+/* Sleep only when the next burst is further away than this; spin closer
+ * in, since a sleep can overshoot by tens of microseconds. */
+#define LOAD_SPIN_NS 100000ull
+
+static volatile sig_atomic_t g_running = 1;
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    g_running = 0;
+}
+
+/* ---- priority distribution ------------------------------------------ */
+
+typedef struct
+{
+    uint32_t cumulative[256]; /* weight of priorities <= p */
+    uint32_t total;
+} PriorityDist;
+
+static int dist_parse(PriorityDist *d, const char *spec)
+{
+    uint32_t weight[256];
+    memset(weight, 0, sizeof(weight));
+    unsigned lo, hi, w;
+    int used;
+
+    if (strchr(spec, ':'))
+    {
+        const char *p = spec;
+        while (sscanf(p, "%u:%u%n", &lo, &w, &used) == 2 && lo <= 255u)
+        {
+            weight[lo] += w;
+            p += used;
+            if (*p != ',')
+                break;
+            p++;
+        }
+        if (*p != '\0')
+            return -1;
+    }
+    else if (sscanf(spec, "%u-%u%n", &lo, &hi, &used) == 2 && spec[used] == '\0')
+    {
+        if (lo > hi || hi > 255u)
+            return -1;
+        for (unsigned p = lo; p <= hi; ++p)
+            weight[p] = 1;
+    }
+    else if (sscanf(spec, "%u%n", &lo, &used) == 1 && spec[used] == '\0' && lo <= 255u)
+    {
+        weight[lo] = 1;
+    }
+    else
+    {
+        return -1;
+    }
+
+    d->total = 0;
+    for (unsigned p = 0; p < 256u; ++p)
+    {
+        d->total += weight[p];
+        d->cumulative[p] = d->total;
+    }
+    return d->total != 0 ? 0 : -1;
+}
+
+static uint32_t xorshift32(uint32_t *state)
+{
+    uint32_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+    *state = x;
+    return x;
+}
+
+static uint8_t dist_draw(const PriorityDist *d, uint32_t *rng)
+{
+    uint32_t r = xorshift32(rng) % d->total;
+    unsigned lo = 0, hi = 255;
+    while (lo < hi) /* first priority whose cumulative weight exceeds r */
+    {
+        unsigned mid = (lo + hi) / 2u;
+        if (d->cumulative[mid] > r)
+            hi = mid;
+        else
+            lo = mid + 1u;
+    }
+    return (uint8_t)lo;
+}
+
+/* ---- pacing ------------------------------------------------------------ */
+
+static uint64_t realtime_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec_to_ns(&ts);
+}
+
+static void wait_until_ns(uint64_t deadline_ns)
+{
+    uint64_t now_ns = monotonic_now_ns();
+    if (deadline_ns > now_ns + LOAD_SPIN_NS)
+    {
+        uint64_t wake_ns = deadline_ns - LOAD_SPIN_NS;
+        struct timespec ts = {(time_t)(wake_ns / 1000000000ull),
+                              (long)(wake_ns % 1000000000ull)};
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    while (monotonic_now_ns() < deadline_ns && g_running)
+    {
+    }
+}
+
+/* Wall-clock offset from the start at which packet number k is due, for
+ * rate packets/s sent only during on_ns out of every period_ns. */
+static uint64_t due_offset_ns(uint64_t k, double rate, uint64_t on_ns, uint64_t period_ns)
+{
+    uint64_t active_ns = (uint64_t)((double)k * 1e9 / rate);
+    if (on_ns == 0)
+        return active_ns;
+    return (active_ns / on_ns) * period_ns + active_ns % on_ns;
+}
+
+/* ---- main -------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    const char *host = "127.0.0.1";
+    uint16_t ports[LOAD_MAX_PORTS] = {5000};
+    size_t port_count = 1;
+    double rate = 1000.0;
+    uint64_t count = 0;
+    double duration_s = -1.0;
+    unsigned burst = 1;
+    unsigned on_ms = 0, off_ms = 0;
+    const char *dist_spec = "0-255";
+    uint32_t freshness_ms = 1000;
+    uint32_t seed = (uint32_t)time(NULL) ^ ((uint32_t)getpid() << 16);
+
+    int opt;
+    while ((opt = getopt(argc, argv, "h:p:r:n:d:b:w:P:f:s:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+        {
+            port_count = 0;
+            for (char *tok = strtok(optarg, ","); tok && port_count < LOAD_MAX_PORTS;
+                 tok = strtok(NULL, ","))
+                ports[port_count++] = (uint16_t)strtoul(tok, NULL, 10);
+            break;
+        }
+        case 'r':
+            rate = strtod(optarg, NULL);
+            break;
+        case 'n':
+            count = strtoull(optarg, NULL, 10);
+            break;
+        case 'd':
+            duration_s = strtod(optarg, NULL);
+            break;
+        case 'b':
+            burst = (unsigned)strtoul(optarg, NULL, 10);
+            break;
+        case 'w':
+            if (sscanf(optarg, "%u/%u", &on_ms, &off_ms) != 2 || on_ms == 0)
+                goto usage;
+            break;
+        case 'P':
+            dist_spec = optarg;
+            break;
+        case 'f':
+            freshness_ms = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        case 's':
+            seed = (uint32_t)strtoul(optarg, NULL, 10);
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc || port_count == 0 || burst == 0 || rate < 0.0)
+        goto usage;
+    if (duration_s < 0.0)
+        duration_s = (count != 0) ? 0.0 : 5.0;
+
+    PriorityDist dist;
+    if (dist_parse(&dist, dist_spec) != 0)
+    {
+        fprintf(stderr, "cp_load: bad priority distribution '%s'\n", dist_spec);
+        return 1;
+    }
+
+    struct sockaddr_in dest[LOAD_MAX_PORTS];
+    for (size_t i = 0; i < port_count; ++i)
+    {
+        memset(&dest[i], 0, sizeof(dest[i]));
+        dest[i].sin_family = AF_INET;
+        dest[i].sin_port = htons(ports[i]);
+        if (inet_pton(AF_INET, host, &dest[i].sin_addr) != 1)
+        {
+            fprintf(stderr, "cp_load: invalid host %s\n", host);
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("cp_load: socket");
+        return 1;
+    }
+    int sndbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_SNDBUF, &sndbuf, sizeof(sndbuf));
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    /* --- Send state.  Each source port gets its own version 2 sequence,
+     *     flagged as a reset on its first packet.                    --- */
+    uint32_t rng = seed ? seed : 1u;
+    const uint16_t run = (uint16_t)xorshift32(&rng);
+    uint32_t port_seq[LOAD_MAX_PORTS] = {0};
+    uint8_t pkts[LOAD_BATCH_MAX][INBOUND_V2_PACKET_SIZE];
+    struct iovec iov[LOAD_BATCH_MAX];
+#ifdef LOAD_HAVE_SENDMMSG
+    struct mmsghdr msgs[LOAD_BATCH_MAX];
+    memset(msgs, 0, sizeof(msgs));
+#else
+    struct
+    {
+        struct msghdr msg_hdr;
+    } msgs[LOAD_BATCH_MAX];
+    memset(msgs, 0, sizeof(msgs));
+#endif
+    for (size_t i = 0; i < LOAD_BATCH_MAX; ++i)
+    {
+        iov[i].iov_base = pkts[i];
+        iov[i].iov_len = INBOUND_V2_PACKET_SIZE;
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_namelen = sizeof(struct sockaddr_in);
+    }
+
+    const uint64_t on_ns = (uint64_t)on_ms * 1000000ull;
+    const uint64_t period_ns = on_ns + (uint64_t)off_ms * 1000000ull;
+    const uint64_t start_ns = monotonic_now_ns();
+    const uint64_t end_ns = (duration_s > 0.0) ? start_ns + (uint64_t)(duration_s * 1e9) : 0;
+    uint64_t seq = 0, sent = 0, failed = 0, bursts = 0, late_bursts = 0, max_late_ns = 0;
+    uint64_t by_priority[256] = {0};
+
+    while (g_running && (count == 0 || seq < count))
+    {
+        /* --- Wait for this burst's deadline. --- */
+        if (rate > 0.0)
+        {
+            uint64_t due_ns = start_ns + due_offset_ns(seq, rate, on_ns, period_ns);
+            if (end_ns != 0 && due_ns >= end_ns)
+                break;
+            wait_until_ns(due_ns);
+            uint64_t late_ns = monotonic_now_ns() - due_ns;
+            if (late_ns > LOAD_SPIN_NS)
+                late_bursts++;
+            if (late_ns > max_late_ns)
+                max_late_ns = late_ns;
+        }
+        else if (end_ns != 0 && monotonic_now_ns() >= end_ns)
+        {
+            break;
+        }
+        bursts++;
+
+        /* --- Send one burst, LOAD_BATCH_MAX packets per call. --- */
+        uint64_t left = burst;
+        if (count != 0 && count - seq < left)
+            left = count - seq;
+        while (left > 0 && g_running)
+        {
+            size_t n = (left < LOAD_BATCH_MAX) ? (size_t)left : LOAD_BATCH_MAX;
+            uint64_t now_ns = realtime_now_ns();
+            for (size_t i = 0; i < n; ++i, ++seq)
+            {
+                size_t port = (size_t)(seq % port_count);
+                uint8_t *pkt = pkts[i];
+                Probe pr = {dist_draw(&dist, &rng), run, (uint32_t)seq, now_ns};
+                probe_encode(pkt, &pr);
+
+                uint8_t *t = pkt + ACKERMANN_PAYLOAD_SIZE;
+                probe_put_be(t, freshness_ms, 4);
+                t[4] = pr.priority;
+                t[5] = INBOUND_VERSION_2;
+                t[6] = (port_seq[port] == 0) ? INBOUND_FLAG_SEQ_RESET : 0u;
+                probe_put_be(t + 7, port_seq[port]++, 4);
+                probe_put_be(t + 11, now_ns, 8);
+
+                msgs[i].msg_hdr.msg_name = &dest[port];
+                by_priority[pr.priority]++;
+            }
+
+#ifdef LOAD_HAVE_SENDMMSG
+            size_t done = 0;
+            while (done < n)
+            {
+                int rc = sendmmsg(fd, &msgs[done], (unsigned)(n - done), 0);
+                if (rc < 0)
+                {
+                    if (errno == EINTR)
+                        continue;
+                    failed += n - done; /* e.g. ENOBUFS: drop the rest */
+                    break;
+                }
+                done += (size_t)rc;
+            }
+            sent += done;
+#else
+            for (size_t i = 0; i < n; ++i)
+            {
+                if (sendmsg(fd, &msgs[i].msg_hdr, 0) < 0)
+                    failed++;
+                else
+                    sent++;
+            }
+#endif
+            left -= n;
+        }
+    }
+
+    double secs = (double)(monotonic_now_ns() - start_ns) / 1e9;
+    printf("cp_load run %u: sent=%llu failed=%llu in %.3f s (%.0f/s)",
+           (unsigned)run, (unsigned long long)sent, (unsigned long long)failed,
+           secs, secs > 0.0 ? (double)sent / secs : 0.0);
+    if (rate > 0.0)
+        printf(", bursts=%llu late=%llu max_late=%.1f us",
+               (unsigned long long)bursts, (unsigned long long)late_bursts,
+               (double)max_late_ns / 1e3);
+    printf("\n");
+
+    unsigned distinct = 0;
+    for (unsigned p = 0; p < 256u; ++p)
+        distinct += (by_priority[p] != 0);
+    if (distinct <= 16u)
+    {
+        for (unsigned p = 0; p < 256u; ++p)
+        {
+            if (by_priority[p] != 0)
+                printf("  priority %3u: %llu\n", p, (unsigned long long)by_priority[p]);
+        }
+    }
+
+    close(fd);
+    return failed != 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-h HOST] [-p PORT[,PORT..]] [-r RATE] [-n COUNT | -d SECONDS]\n"
+                    "       [-b BURST] [-w ON_MS/OFF_MS] [-P N | LO-HI | P:W,P:W..] [-f MS] [-s SEED]\n",
+            argv[0]);
+    return 1;
+}
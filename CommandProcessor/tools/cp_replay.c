@@ -0,0 +1,339 @@
+/* -----------------------------------------------------------------------
+ * cp_replay — re-inject a traffic capture into a command processor.
+ *
+ * Reads a file written with `command_processor --capture FILE` (format in
+ * capture.h) and sends every datagram again, byte for byte, to the port
+ * its source was received on, keeping the original inter-arrival times
+ * (records of different channels are merged back into receive order):
+ *
+ *   -x N       speed factor: 1 = as captured (default), 10 = ten times
+ *              faster, 0.5 = half speed
+ *   -m         maximum speed: send back to back, no pacing
+ *   -n LOOPS   play the capture LOOPS times back to back (default 1)
+ *   -h HOST    destination address (default 127.0.0.1)
+ *   -p ID=PORT send source ID to PORT instead of its captured port
+ *   -k         keep version 2 sender timestamps as captured
+ *
+ * Send times are absolute CLOCK_MONOTONIC deadlines, so pacing does not
+ * drift with send cost; how far the sends fell behind schedule is
+ * reported at the end.
+ *
+ * By default the sender timestamp of each version 2 packet is replaced
+ * with the current CLOCK_REALTIME.  The processor then sees a sender
+ * restart whenever a loop begins again with old sequence numbers, rather
+ * than dropping the whole loop as duplicates, and its transit histograms
+ * stay meaningful.  With -k the packets are sent exactly as captured.
+ *
+ * Usage:  cp_replay [-x N | -m] [-n LOOPS] [-h HOST] [-p ID=PORT]... [-k] FILE
+ * ----------------------------------------------------------------------- */
+#include "capture.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Offsets in a version 2 datagram; see the wire format in
+ * command_interface.c. */
+#define V2_VERSION_OFFSET (ACKERMANN_PAYLOAD_SIZE + 5u)
+#define V2_SENDER_TS_OFFSET (ACKERMANN_PAYLOAD_SIZE + 11u)
+
+typedef struct
+{
+    uint64_t rx_ns; /* relative to the capture start */
+    uint8_t source;
+    uint8_t len;
+    const uint8_t *data; /* points into the file buffer */
+} Record;
+
+/* Receive order; ties keep their file order. */
+static int record_cmp(const void *a, const void *b)
+{
+    const Record *x = (const Record *)a, *y = (const Record *)b;
+    if (x->rx_ns != y->rx_ns)
+        return (x->rx_ns < y->rx_ns) ? -1 : 1;
+    return (x->data > y->data) - (x->data < y->data);
+}
+
+static inline uint16_t get_le16(const uint8_t *p)
+{
+    return (uint16_t)(p[0] | (p[1] << 8));
+}
+
+static inline uint32_t get_le32(const uint8_t *p)
+{
+    return (uint32_t)get_le16(p) | ((uint32_t)get_le16(p + 2) << 16);
+}
+
+static inline uint64_t get_le64(const uint8_t *p)
+{
+    return (uint64_t)get_le32(p) | ((uint64_t)get_le32(p + 4) << 32);
+}
+
+static inline void put_be64(uint8_t *p, uint64_t v)
+{
+    for (unsigned i = 0; i < 8u; ++i)
+        p[i] = (uint8_t)(v >> (56u - 8u * i));
+}
+
+static uint64_t realtime_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return timespec_to_ns(&ts);
+}
+
+static void sleep_until_ns(uint64_t deadline_ns)
+{
+    struct timespec ts;
+    ts.tv_sec = (time_t)(deadline_ns / 1000000000ull);
+    ts.tv_nsec = (long)(deadline_ns % 1000000000ull);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+/* Read the whole file into memory. */
+static uint8_t *load_file(const char *path, size_t *size)
+{
+    FILE *f = fopen(path, "rb");
+    if (!f)
+    {
+        fprintf(stderr, "cp_replay: %s: %s\n", path, strerror(errno));
+        return NULL;
+    }
+
+    size_t cap = 1u << 16, len = 0;
+    uint8_t *buf = malloc(cap);
+    while (buf)
+    {
+        len += fread(buf + len, 1, cap - len, f);
+        if (len < cap)
+            break;
+        cap *= 2u;
+        uint8_t *grown = realloc(buf, cap);
+        if (!grown)
+            free(buf);
+        buf = grown;
+    }
+    if (!buf || ferror(f))
+    {
+        fprintf(stderr, "cp_replay: %s: read failed\n", path);
+        free(buf);
+        buf = NULL;
+    }
+    fclose(f);
+    *size = len;
+    return buf;
+}
+
+int main(int argc, char **argv)
+{
+    double speed = 1.0;
+    int max_speed = 0;
+    long loops = 1;
+    const char *host = "127.0.0.1";
+    int keep_stamps = 0;
+    int port_override[256];
+    for (size_t i = 0; i < 256u; ++i)
+        port_override[i] = -1;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "x:mn:h:p:k")) != -1)
+    {
+        switch (opt)
+        {
+        case 'x':
+            speed = strtod(optarg, NULL);
+            break;
+        case 'm':
+            max_speed = 1;
+            break;
+        case 'n':
+            loops = strtol(optarg, NULL, 10);
+            break;
+        case 'h':
+            host = optarg;
+            break;
+        case 'p':
+        {
+            unsigned id, port;
+            if (sscanf(optarg, "%u=%u", &id, &port) != 2 || id > 255u || port > 65535u)
+            {
+                fprintf(stderr, "cp_replay: bad -p %s (expected ID=PORT)\n", optarg);
+                return 1;
+            }
+            port_override[id] = (int)port;
+            break;
+        }
+        case 'k':
+            keep_stamps = 1;
+            break;
+        default:
+            goto usage;
+        }
+    }
+    if (optind != argc - 1 || loops < 1 || (!max_speed && speed <= 0.0))
+        goto usage;
+
+    /* --- Load and index the capture. --- */
+    size_t size;
+    uint8_t *file = load_file(argv[optind], &size);
+    if (!file)
+        return 1;
+
+    if (size < CAPTURE_HEADER_SIZE || get_le32(file) != CAPTURE_MAGIC ||
+        get_le16(file + 4) != CAPTURE_VERSION)
+    {
+        fprintf(stderr, "cp_replay: %s: not a version %u capture\n",
+                argv[optind], (unsigned)CAPTURE_VERSION);
+        return 1;
+    }
+    size_t source_count = get_le16(file + 6);
+    size_t off = CAPTURE_HEADER_SIZE + source_count * CAPTURE_SOURCE_SIZE;
+    if (off > size)
+    {
+        fprintf(stderr, "cp_replay: %s: truncated header\n", argv[optind]);
+        return 1;
+    }
+
+    struct sockaddr_in dest[256];
+    for (size_t i = 0; i < source_count; ++i)
+    {
+        const uint8_t *entry = file + CAPTURE_HEADER_SIZE + i * CAPTURE_SOURCE_SIZE;
+        char name[CAPTURE_NAME_LEN + 1];
+        memcpy(name, entry, CAPTURE_NAME_LEN);
+        name[CAPTURE_NAME_LEN] = '\0';
+        uint16_t port = (port_override[i] >= 0) ? (uint16_t)port_override[i]
+                                                : get_le16(entry + CAPTURE_NAME_LEN);
+
+        memset(&dest[i], 0, sizeof(dest[i]));
+        dest[i].sin_family = AF_INET;
+        dest[i].sin_port = htons(port);
+        if (inet_pton(AF_INET, host, &dest[i].sin_addr) != 1)
+        {
+            fprintf(stderr, "cp_replay: invalid host %s\n", host);
+            return 1;
+        }
+        fprintf(stderr, "source %zu %-8s -> %s:%u\n", i, name, host, (unsigned)port);
+    }
+
+    size_t count = 0, cap = 1024, malformed = 0;
+    int truncated = 0;
+    Record *recs = malloc(cap * sizeof(Record));
+    while (recs && off + CAPTURE_RECORD_HEADER_SIZE <= size)
+    {
+        Record r;
+        r.rx_ns = get_le64(file + off);
+        r.source = file[off + 8];
+        r.len = file[off + 9];
+        r.data = file + off + CAPTURE_RECORD_HEADER_SIZE;
+        if (off + CAPTURE_RECORD_HEADER_SIZE + r.len > size)
+        {
+            truncated = 1; /* capture cut short, e.g. by a crash */
+            break;
+        }
+        off += CAPTURE_RECORD_HEADER_SIZE + r.len;
+        if (r.source >= source_count || r.len > CAPTURE_DATAGRAM_MAX)
+        {
+            malformed++; /* never written by the processor: skip it */
+            continue;
+        }
+
+        if (count == cap)
+        {
+            cap *= 2u;
+            Record *grown = realloc(recs, cap * sizeof(Record));
+            if (!grown)
+                free(recs);
+            recs = grown;
+            if (!recs)
+                break;
+        }
+        recs[count++] = r;
+    }
+    if (!recs)
+    {
+        perror("cp_replay: malloc");
+        return 1;
+    }
+    if (truncated)
+        fprintf(stderr, "cp_replay: %s: last record truncated, ignored\n", argv[optind]);
+    if (malformed != 0)
+        fprintf(stderr, "cp_replay: %s: %zu malformed record(s) skipped\n", argv[optind],
+                malformed);
+    if (count == 0)
+    {
+        fprintf(stderr, "cp_replay: %s: no records\n", argv[optind]);
+        return 1;
+    }
+    qsort(recs, count, sizeof(Record), record_cmp);
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("cp_replay: socket");
+        return 1;
+    }
+
+    /* --- Replay on absolute deadlines. --- */
+    const uint64_t first_ns = recs[0].rx_ns;
+    const uint64_t span_ns = recs[count - 1].rx_ns - first_ns;
+    const uint64_t start_ns = monotonic_now_ns();
+    uint64_t sent = 0, failed = 0, max_late_ns = 0;
+
+    for (long loop = 0; loop < loops; ++loop)
+    {
+        for (size_t i = 0; i < count; ++i)
+        {
+            const Record *r = &recs[i];
+            if (!max_speed)
+            {
+                /* One loop spans the capture plus the average gap, so
+                 * back-to-back loops keep the captured rate. */
+                uint64_t at_ns = (uint64_t)loop * (span_ns + span_ns / count) +
+                                 (r->rx_ns - first_ns);
+                uint64_t due_ns = start_ns + (uint64_t)((double)at_ns / speed);
+                sleep_until_ns(due_ns);
+                uint64_t now_ns = monotonic_now_ns();
+                if (now_ns > due_ns && now_ns - due_ns > max_late_ns)
+                    max_late_ns = now_ns - due_ns;
+            }
+
+            uint8_t pkt[CAPTURE_DATAGRAM_MAX];
+            memcpy(pkt, r->data, r->len);
+            if (!keep_stamps && r->len == INBOUND_V2_PACKET_SIZE &&
+                pkt[V2_VERSION_OFFSET] == INBOUND_VERSION_2)
+                put_be64(pkt + V2_SENDER_TS_OFFSET, realtime_now_ns());
+
+            if (sendto(fd, pkt, r->len, 0, (const struct sockaddr *)&dest[r->source],
+                       sizeof(dest[r->source])) < 0)
+                failed++;
+            else
+                sent++;
+        }
+    }
+
+    double secs = (double)(monotonic_now_ns() - start_ns) / 1e9;
+    printf("replayed %zu records x %ld: sent=%llu failed=%llu in %.3f s (%.0f/s, capture span %.3f s)",
+           count, loops, (unsigned long long)sent, (unsigned long long)failed,
+           secs, secs > 0.0 ? (double)sent / secs : 0.0, (double)span_ns / 1e9);
+    if (!max_speed)
+        printf(", max lateness %.1f us", (double)max_late_ns / 1e3);
+    printf("\n");
+
+    close(fd);
+    free(recs);
+    free(file);
+    return failed != 0;
+
+usage:
+    fprintf(stderr, "usage: %s [-x N | -m] [-n LOOPS] [-h HOST] [-p ID=PORT]... [-k] FILE\n",
+            argv[0]);
+    return 1;
+}
@@ -0,0 +1,379 @@
+/* -----------------------------------------------------------------------
+ * cp_sink — motor-controller stand-in that measures what cp_load sent.
+ *
+ * Receives forwarded commands on the MCU port, decodes the cp_load probe
+ * in each payload and matches it back to its send by run id and sequence
+ * number:
+ *
+ *   -p PORT     port to listen on (default 5001, MCU_TARGET_PORT)
+ *   -a          echo the 4-byte ack tag of tagged datagrams (for
+ *               MCU_ACK_TIMEOUT_MS), like listen.py --ack
+ *   -i MS       progress line interval (default 1000, 0 = none)
+ *   -t MS       end a run after this much silence (default 2000)
+ *
+ * A run ends after the silence timeout, when a datagram from a different
+ * cp_load run arrives, or on Ctrl-C.  For each run it prints throughput,
+ * loss (sequence numbers never received), duplicates, reordering, and
+ * send-to-receive latency percentiles overall and per priority (the
+ * priority cp_load sent, before any source ceiling).  Receive
+ * time is the kernel stamp, so time spent in the sink's own socket queue
+ * still counts.
+ *
+ * Commands the processor drops on purpose — evicted, expired or coalesced
+ * — show up as loss; compare with its shutdown counters.
+ *
+ * Usage:  cp_sink [-p PORT] [-a] [-i MS] [-t MS]
+ * ----------------------------------------------------------------------- */
+#define _GNU_SOURCE /* recvmmsg on glibc */
+#include "latency_hist.h"
+#include "probe.h"
+#include "rx_timestamp.h"
+
+#include <errno.h>
+#include <netinet/in.h>
+#include <poll.h>
+#include <signal.h>
+#include <stddef.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+/* Batched receive is available on Linux and QNX 7+; elsewhere fall back
+ * to one recvmsg per datagram. */
+#if defined(__linux__) || defined(__QNXNTO__)
+#define SINK_HAVE_RECVMMSG 1
+#endif
+
+#define SINK_BATCH_MAX 64u
+
+/* With more priorities than this in a run, latency is reported in bands
+ * of SINK_BAND_WIDTH priorities instead of one line per priority. */
+#define SINK_MAX_PRIORITY_LINES 16u
+#define SINK_BAND_WIDTH 16u
+
+/* Ack tag appended by the processor's ack channel (MCU_ACK_TAG_SIZE). */
+#define SINK_ACK_TAG_SIZE 4u
+
+static volatile sig_atomic_t g_running = 1;
+
+static void signal_handler(int sig)
+{
+    (void)sig;
+    g_running = 0;
+}
+
+/* ---- per-run statistics ------------------------------------------------ */
+
+typedef struct
+{
+    int active;
+    uint16_t run;
+    uint64_t received; /* probes of this run, duplicates included */
+    uint64_t distinct;
+    uint64_t duplicates;
+    uint64_t reordered;   /* arrived after a higher sequence number */
+    uint64_t clock_skew;  /* receive stamp before send stamp        */
+    uint32_t max_seq;
+    uint64_t first_ns, last_ns; /* monotonic receive times */
+    uint8_t *seen;              /* one bit per sequence number */
+    size_t seen_bytes;
+    LatencyHist all;
+    LatencyHist by_priority[256];
+} Run;
+
+static int run_mark_seen(Run *r, uint32_t seq)
+{
+    size_t byte = seq / 8u;
+    if (byte >= r->seen_bytes)
+    {
+        size_t grown = r->seen_bytes ? r->seen_bytes : 4096u;
+        while (grown <= byte)
+            grown *= 2u;
+        uint8_t *p = realloc(r->seen, grown);
+        if (!p)
+            return -1;
+        memset(p + r->seen_bytes, 0, grown - r->seen_bytes);
+        r->seen = p;
+        r->seen_bytes = grown;
+    }
+
+    uint8_t bit = (uint8_t)(1u << (seq % 8u));
+    int dup = (r->seen[byte] & bit) != 0;
+    r->seen[byte] |= bit;
+    return dup;
+}
+
+static void run_reset(Run *r, uint16_t run)
+{
+    uint8_t *seen = r->seen;
+    size_t seen_bytes = r->seen_bytes;
+    memset(r, 0, offsetof(Run, all));
+    if (seen)
+        memset(seen, 0, seen_bytes);
+    r->seen = seen;
+    r->seen_bytes = seen_bytes;
+    r->active = 1;
+    r->run = run;
+    lat_hist_init(&r->all);
+    for (unsigned p = 0; p < 256u; ++p)
+        lat_hist_init(&r->by_priority[p]);
+}
+
+static void hist_merge(LatencyHist *into, const LatencyHist *h)
+{
+    if (h->count == 0)
+        return;
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+        into->buckets[b] += h->buckets[b];
+    if (h->min_ns < into->min_ns)
+        into->min_ns = h->min_ns;
+    if (h->max_ns > into->max_ns)
+        into->max_ns = h->max_ns;
+    into->count += h->count;
+    into->sum_ns += h->sum_ns;
+}
+
+static void run_report(Run *r)
+{
+    if (!r->active)
+        return;
+
+    uint64_t expected = (uint64_t)r->max_seq + 1u;
+    uint64_t lost = expected - r->distinct;
+    double secs = (double)(r->last_ns - r->first_ns) / 1e9;
+    printf("run %u: received=%llu distinct=%llu lost=%llu (%.3f%% of %llu) duplicates=%llu "
+           "reordered=%llu in %.3f s (%.0f/s)\n",
+           (unsigned)r->run, (unsigned long long)r->received,
+           (unsigned long long)r->distinct, (unsigned long long)lost,
+           100.0 * (double)lost / (double)expected, (unsigned long long)expected,
+           (unsigned long long)r->duplicates, (unsigned long long)r->reordered,
+           secs, secs > 0.0 ? (double)r->distinct / secs : 0.0);
+    if (r->clock_skew != 0)
+        printf("  %llu latencies not recorded: receive before send (clocks not in sync?)\n",
+               (unsigned long long)r->clock_skew);
+
+    lat_hist_print(stdout, "  latency all", &r->all);
+    unsigned active = 0;
+    for (unsigned p = 0; p < 256u; ++p)
+        active += (r->by_priority[p].count != 0);
+    unsigned width = (active > SINK_MAX_PRIORITY_LINES) ? SINK_BAND_WIDTH : 1u;
+    for (unsigned lo = 0; lo < 256u; lo += width)
+    {
+        LatencyHist band;
+        lat_hist_init(&band);
+        for (unsigned p = lo; p < lo + width; ++p)
+            hist_merge(&band, &r->by_priority[p]);
+        if (band.count == 0)
+            continue;
+
+        char label[32];
+        if (width == 1u)
+            snprintf(label, sizeof(label), "  priority %3u", lo);
+        else
+            snprintf(label, sizeof(label), "  priority %3u-%3u", lo, lo + width - 1u);
+        lat_hist_print(stdout, label, &band);
+    }
+    fflush(stdout);
+    r->active = 0;
+}
+
+static void run_record(Run *r, const Probe *pr, uint64_t recv_mono_ns, int64_t real_to_mono_ns)
+{
+    if (!r->active || pr->run != r->run)
+    {
+        run_report(r);
+        run_reset(r, pr->run);
+        r->first_ns = recv_mono_ns;
+    }
+    r->last_ns = recv_mono_ns;
+    r->received++;
+
+    int dup = run_mark_seen(r, pr->seq);
+    if (dup != 0)
+    {
+        r->duplicates += (dup > 0);
+        return;
+    }
+    r->distinct++;
+    if (r->distinct > 1 && pr->seq < r->max_seq)
+        r->reordered++;
+    if (pr->seq > r->max_seq || r->distinct == 1)
+        r->max_seq = pr->seq;
+
+    int64_t recv_real_ns = (int64_t)recv_mono_ns - real_to_mono_ns;
+    int64_t lat_ns = recv_real_ns - (int64_t)pr->send_ns;
+    if (lat_ns < 0)
+    {
+        r->clock_skew++;
+        return;
+    }
+    lat_hist_record(&r->all, (uint64_t)lat_ns);
+    lat_hist_record(&r->by_priority[pr->priority], (uint64_t)lat_ns);
+}
+
+/* ---- main -------------------------------------------------------------- */
+
+int main(int argc, char **argv)
+{
+    uint16_t port = 5001;
+    int ack = 0;
+    long interval_ms = 1000;
+    long idle_ms = 2000;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "p:ai:t:")) != -1)
+    {
+        switch (opt)
+        {
+        case 'p':
+            port = (uint16_t)strtoul(optarg, NULL, 10);
+            break;
+        case 'a':
+            ack = 1;
+            break;
+        case 'i':
+            interval_ms = strtol(optarg, NULL, 10);
+            break;
+        case 't':
+            idle_ms = strtol(optarg, NULL, 10);
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-p PORT] [-a] [-i MS] [-t MS]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0)
+    {
+        perror("cp_sink: socket");
+        return 1;
+    }
+    int rcvbuf = 4 * 1024 * 1024;
+    setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+    struct sockaddr_in addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0)
+    {
+        perror("cp_sink: bind");
+        return 1;
+    }
+    if (rx_timestamp_enable(fd) < 0)
+        perror("cp_sink: receive timestamps");
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+    printf("cp_sink listening on :%u%s\n", (unsigned)port, ack ? " (acking)" : "");
+    fflush(stdout);
+
+    /* --- Receive buffers.  One spare byte detects oversized datagrams. --- */
+    static uint8_t bufs[SINK_BATCH_MAX][ACKERMANN_PAYLOAD_SIZE + SINK_ACK_TAG_SIZE + 1];
+    static struct sockaddr_in from[SINK_BATCH_MAX];
+    static RxControl control[SINK_BATCH_MAX];
+    static struct iovec iov[SINK_BATCH_MAX];
+#ifdef SINK_HAVE_RECVMMSG
+    static struct mmsghdr msgs[SINK_BATCH_MAX];
+#else
+    static struct
+    {
+        struct msghdr msg_hdr;
+    } msgs[1];
+#endif
+    const size_t slots = sizeof(msgs) / sizeof(msgs[0]);
+    for (size_t i = 0; i < slots; ++i)
+    {
+        iov[i].iov_base = bufs[i];
+        iov[i].iov_len = sizeof(bufs[i]);
+        msgs[i].msg_hdr.msg_iov = &iov[i];
+        msgs[i].msg_hdr.msg_iovlen = 1;
+        msgs[i].msg_hdr.msg_name = &from[i];
+        msgs[i].msg_hdr.msg_control = control[i].buf;
+    }
+
+    static Run run; /* 256 histograms — keep off the stack */
+    uint64_t foreign = 0, interval_rx = 0;
+    uint64_t next_progress_ns = monotonic_now_ns() + (uint64_t)interval_ms * 1000000ull;
+    struct pollfd pfd = {fd, POLLIN, 0};
+
+    while (g_running)
+    {
+        int ready = poll(&pfd, 1, 100);
+        uint64_t now_ns = monotonic_now_ns();
+
+        if (interval_ms > 0 && now_ns >= next_progress_ns)
+        {
+            if (interval_rx != 0)
+            {
+                printf("%8.0f/s  run %u: distinct=%llu lost=%llu duplicates=%llu\n",
+                       (double)interval_rx * 1000.0 / (double)interval_ms,
+                       (unsigned)run.run, (unsigned long long)run.distinct,
+                       (unsigned long long)((uint64_t)run.max_seq + 1u - run.distinct),
+                       (unsigned long long)run.duplicates);
+                fflush(stdout);
+            }
+            interval_rx = 0;
+            next_progress_ns = now_ns + (uint64_t)interval_ms * 1000000ull;
+        }
+        if (run.active && now_ns - run.last_ns > (uint64_t)idle_ms * 1000000ull)
+            run_report(&run);
+        if (ready <= 0)
+            continue;
+
+        for (size_t i = 0; i < slots; ++i)
+        {
+            msgs[i].msg_hdr.msg_namelen = sizeof(from[i]);
+            msgs[i].msg_hdr.msg_controllen = sizeof(control[i].buf);
+        }
+        size_t lens[SINK_BATCH_MAX];
+#ifdef SINK_HAVE_RECVMMSG
+        int received = recvmmsg(fd, msgs, SINK_BATCH_MAX, MSG_DONTWAIT, NULL);
+        for (int i = 0; i < received; ++i)
+            lens[i] = msgs[i].msg_len;
+#else
+        ssize_t n = recvmsg(fd, &msgs[0].msg_hdr, MSG_DONTWAIT);
+        int received = (n < 0) ? -1 : 1;
+        if (n >= 0)
+            lens[0] = (size_t)n;
+#endif
+        if (received < 0)
+        {
+            if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)
+                perror("cp_sink: recv");
+            continue;
+        }
+
+        uint64_t mono_now_ns;
+        int64_t real_to_mono_ns = rx_real_to_mono_ns(&mono_now_ns);
+        for (int i = 0; i < received; ++i)
+        {
+            Probe pr;
+            if ((lens[i] != ACKERMANN_PAYLOAD_SIZE &&
+                 lens[i] != ACKERMANN_PAYLOAD_SIZE + SINK_ACK_TAG_SIZE) ||
+                probe_decode(bufs[i], &pr) != 0)
+            {
+                foreign++; /* not from cp_load, e.g. a watchdog stop */
+                continue;
+            }
+            interval_rx++;
+
+            uint64_t recv_ns = rx_timestamp_ns(&msgs[i].msg_hdr, real_to_mono_ns, mono_now_ns);
+            run_record(&run, &pr, recv_ns, real_to_mono_ns);
+
+            if (ack && lens[i] == ACKERMANN_PAYLOAD_SIZE + SINK_ACK_TAG_SIZE)
+                sendto(fd, bufs[i] + ACKERMANN_PAYLOAD_SIZE, SINK_ACK_TAG_SIZE, MSG_DONTWAIT,
+                       (struct sockaddr *)&from[i], msgs[i].msg_hdr.msg_namelen);
+        }
+    }
+
+    run_report(&run);
+    if (foreign != 0)
+        printf("%llu datagrams were not cp_load probes\n", (unsigned long long)foreign);
+    free(run.seen);
+    close(fd);
+    return 0;
+}
@@ -0,0 +1,249 @@
+/* -----------------------------------------------------------------------
+ * cp_stat — live view of a running command processor.
+ *
+ * Maps the metrics page (METRICS_SHM_NAME) read-only and prints one line
+ * per interval: rates over the interval, pool depth and high-water mark,
+ * and running totals, summed over every channel.  With -c it also prints
+ * one line per channel, so a flood on one channel can be seen not to
+ * touch the others.  With -s it also prints one line per source, so a
+ * flooding sender shows up as its throttle rate.  With -l it also prints,
+ * per priority that saw traffic in the interval, the receive-to-forward
+ * latency percentiles of just that interval.
+ *
+ * Reading never blocks or signals the command processor: the page is a
+ * seqlock that the processor's main thread rewrites every
+ * METRICS_PUBLISH_MS, so sampling faster than that just repeats values.
+ *
+ * Usage:  cp_stat [-i interval_ms] [-n samples] [-c] [-s] [-l]
+ * ----------------------------------------------------------------------- */
+#include "metrics.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/* Reprint the column header every this many lines. */
+#define HEADER_EVERY 20
+
+static const MetricsPage *attach(void)
+{
+    int fd = shm_open(METRICS_SHM_NAME, O_RDONLY, 0);
+    if (fd < 0)
+    {
+        fprintf(stderr, "cp_stat: %s: %s (is the command processor running?)\n",
+                METRICS_SHM_NAME, strerror(errno));
+        return NULL;
+    }
+
+    void *addr = mmap(NULL, sizeof(MetricsPage), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (addr == MAP_FAILED)
+    {
+        perror("cp_stat: mmap");
+        return NULL;
+    }
+    return (const MetricsPage *)addr;
+}
+
+/* Latency recorded between two snapshots of the same histogram.  min/max
+ * are bucket bounds, since the exact values are only kept overall. */
+static void hist_delta(const LatencyHist *cur, const LatencyHist *prev, LatencyHist *out)
+{
+    lat_hist_init(out);
+    for (unsigned b = 0; b < LAT_HIST_BUCKETS; ++b)
+    {
+        out->buckets[b] = cur->buckets[b] - prev->buckets[b];
+        if (out->buckets[b] == 0)
+            continue;
+
+        uint64_t lower = (b == 0) ? 0u : ((uint64_t)1 << (b - 1u));
+        uint64_t upper = (b == 0) ? 0u : (b >= 64u ? UINT64_MAX : ((uint64_t)1 << b) - 1u);
+        if (lower < out->min_ns)
+            out->min_ns = lower;
+        out->max_ns = (upper < cur->max_ns) ? upper : cur->max_ns;
+    }
+    out->count = cur->count - prev->count;
+    out->sum_ns = cur->sum_ns - prev->sum_ns;
+}
+
+static double per_sec(uint64_t cur, uint64_t prev, double secs)
+{
+    return (secs > 0.0) ? (double)(cur - prev) / secs : 0.0;
+}
+
+int main(int argc, char **argv)
+{
+    long interval_ms = 1000;
+    long samples = -1; /* forever */
+    int show_latency = 0;
+    int show_channels = 0;
+    int show_sources = 0;
+
+    int opt;
+    while ((opt = getopt(argc, argv, "i:n:csl")) != -1)
+    {
+        switch (opt)
+        {
+        case 'i':
+            interval_ms = strtol(optarg, NULL, 10);
+            break;
+        case 'n':
+            samples = strtol(optarg, NULL, 10);
+            break;
+        case 'c':
+            show_channels = 1;
+            break;
+        case 's':
+            show_sources = 1;
+            break;
+        case 'l':
+            show_latency = 1;
+            break;
+        default:
+            fprintf(stderr, "usage: %s [-i interval_ms] [-n samples] [-c] [-s] [-l]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (interval_ms <= 0)
+    {
+        fprintf(stderr, "cp_stat: interval must be positive\n");
+        return 1;
+    }
+
+    const MetricsPage *page = attach();
+    if (!page)
+        return 1;
+
+    /* Two snapshots (current / previous) — too large for the stack. */
+    MetricsPage *cur = malloc(sizeof(MetricsPage));
+    MetricsPage *prev = malloc(sizeof(MetricsPage));
+    if (!cur || !prev)
+    {
+        perror("cp_stat: malloc");
+        return 1;
+    }
+    int rc = metrics_read(page, prev);
+    if (rc == -2)
+    {
+        fprintf(stderr, "cp_stat: publisher stalled mid-update (processor killed or stopped?)\n");
+        return 1;
+    }
+    if (rc != 0)
+    {
+        fprintf(stderr, "cp_stat: metrics page not ready or from another version "
+                        "(expected v%u, %zu bytes)\n",
+                METRICS_VERSION, sizeof(MetricsPage));
+        return 1;
+    }
+
+    const struct timespec period = {interval_ms / 1000, (interval_ms % 1000) * 1000000L};
+    for (long n = 0; samples < 0 || n < samples; ++n)
+    {
+        nanosleep(&period, NULL);
+        rc = metrics_read(page, cur);
+        if (rc == -2)
+        {
+            fprintf(stderr, "cp_stat: publisher stalled mid-update (processor killed or stopped?)\n");
+            return 1;
+        }
+        if (rc != 0)
+        {
+            fprintf(stderr, "cp_stat: metrics page gone or replaced\n");
+            return 1;
+        }
+        if (cur->pid != prev->pid)
+        {
+            printf("-- command processor restarted (pid %u) --\n", cur->pid);
+            memcpy(prev, cur, sizeof(*cur));
+            continue;
+        }
+
+        double secs = (double)(cur->publish_ns - prev->publish_ns) / 1e9;
+        uint64_t age_ms = (monotonic_now_ns() - cur->publish_ns) / 1000000ull;
+
+        if (n % HEADER_EVERY == 0)
+            printf("%8s %8s %8s %8s %8s %6s %6s %10s %10s %10s %10s %10s %7s\n",
+                   "recv/s", "thr/s", "drop/s", "exp/s", "fwd/s", "depth", "hwm",
+                   "received", "throttled", "dropped", "expired", "forwarded", "age_ms");
+
+        printf("%8.0f %8.0f %8.0f %8.0f %8.0f %6llu %6llu %10llu %10llu %10llu %10llu %10llu %7llu%s\n",
+               per_sec(cur->received, prev->received, secs),
+               per_sec(cur->throttled, prev->throttled, secs),
+               per_sec(cur->dropped, prev->dropped, secs),
+               per_sec(cur->expired, prev->expired, secs),
+               per_sec(cur->forwarded, prev->forwarded, secs),
+               (unsigned long long)cur->pool_depth,
+               (unsigned long long)cur->pool_depth_hwm,
+               (unsigned long long)cur->received,
+               (unsigned long long)cur->throttled,
+               (unsigned long long)cur->dropped,
+               (unsigned long long)cur->expired,
+               (unsigned long long)cur->forwarded,
+               (unsigned long long)age_ms,
+               (age_ms > 4u * cur->publish_interval_ms) ? "  (stale)" : "");
+
+        if (show_channels)
+        {
+            for (uint32_t i = 0; i < cur->channel_count && i < METRICS_MAX_CHANNELS; ++i)
+            {
+                const MetricsChannel *c = &cur->channels[i], *p = &prev->channels[i];
+                printf("  [%-6.*s] recv/s=%.0f thr/s=%.0f drop/s=%.0f exp/s=%.0f fwd/s=%.0f"
+                       "  depth=%llu hwm=%llu\n",
+                       (int)METRICS_NAME_LEN, c->name,
+                       per_sec(c->received, p->received, secs),
+                       per_sec(c->throttled, p->throttled, secs),
+                       per_sec(c->dropped, p->dropped, secs),
+                       per_sec(c->expired, p->expired, secs),
+                       per_sec(c->forwarded, p->forwarded, secs),
+                       (unsigned long long)c->depth,
+                       (unsigned long long)c->depth_hwm);
+            }
+        }
+
+        if (show_sources)
+        {
+            for (uint32_t i = 0; i < cur->source_count && i < METRICS_MAX_SOURCES; ++i)
+            {
+                const MetricsSource *c = &cur->sources[i], *p = &prev->sources[i];
+                printf("  %-8.*s recv/s=%.0f thr/s=%.0f drop/s=%.0f bad/s=%.0f"
+                       "  throttled=%llu dropped=%llu\n",
+                       (int)METRICS_NAME_LEN, c->name,
+                       per_sec(c->received, p->received, secs),
+                       per_sec(c->throttled, p->throttled, secs),
+                       per_sec(c->dropped, p->dropped, secs),
+                       per_sec(c->malformed, p->malformed, secs),
+                       (unsigned long long)c->throttled,
+                       (unsigned long long)c->dropped);
+            }
+        }
+
+        if (show_latency)
+        {
+            for (size_t p = 0; p < POOL_PRIORITY_LEVELS; ++p)
+            {
+                if (cur->latency[p].count == prev->latency[p].count)
+                    continue;
+
+                LatencyHist delta;
+                hist_delta(&cur->latency[p], &prev->latency[p], &delta);
+                char label[32];
+                snprintf(label, sizeof(label), "  priority %3zu", p);
+                lat_hist_print(stdout, label, &delta);
+            }
+        }
+        fflush(stdout);
+
+        MetricsPage *t = prev;
+        prev = cur;
+        cur = t;
+    }
+
+    free(cur);
+    free(prev);
+    return 0;
+}
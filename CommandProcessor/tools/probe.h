@@ -0,0 +1,71 @@
+#ifndef PROBE_H
+#define PROBE_H
+
+#include <stdint.h>
+
+#include "command_pool.h"
+
+/* -----------------------------------------------------------------------
+ * Probe payload shared by cp_load and cp_sink.
+ *
+ * The processor forwards the Ackermann payload untouched, so cp_load puts
+ * everything cp_sink needs to match a forwarded command back to its send
+ * into the payload itself (big-endian, like the wire trailer):
+ *
+ *   Offset  Size  Field
+ *   0       1     magic     PROBE_MAGIC
+ *   1       1     priority  priority the command was sent with
+ *   2       2     run       random id of the cp_load run
+ *   4       4     seq       per-run sequence number, from 0
+ *   8       8     send_ns   CLOCK_REALTIME just before the send
+ *
+ * Latency is the sink's kernel receive stamp minus send_ns, so across two
+ * machines it is only as good as their clock synchronisation.
+ * ----------------------------------------------------------------------- */
+
+#define PROBE_MAGIC 0xA7u
+
+typedef struct
+{
+    uint8_t priority;
+    uint16_t run;
+    uint32_t seq;
+    uint64_t send_ns;
+} Probe;
+
+static inline void probe_put_be(uint8_t *p, uint64_t v, unsigned bytes)
+{
+    for (unsigned i = 0; i < bytes; ++i)
+        p[i] = (uint8_t)(v >> (8u * (bytes - 1u - i)));
+}
+
+static inline uint64_t probe_get_be(const uint8_t *p, unsigned bytes)
+{
+    uint64_t v = 0;
+    for (unsigned i = 0; i < bytes; ++i)
+        v = (v << 8) | p[i];
+    return v;
+}
+
+static inline void probe_encode(uint8_t payload[ACKERMANN_PAYLOAD_SIZE], const Probe *pr)
+{
+    payload[0] = PROBE_MAGIC;
+    payload[1] = pr->priority;
+    probe_put_be(payload + 2, pr->run, 2);
+    probe_put_be(payload + 4, pr->seq, 4);
+    probe_put_be(payload + 8, pr->send_ns, 8);
+}
+
+/* Returns 0, or -1 if the payload is not a probe. */
+static inline int probe_decode(const uint8_t *payload, Probe *pr)
+{
+    if (payload[0] != PROBE_MAGIC)
+        return -1;
+    pr->priority = payload[1];
+    pr->run = (uint16_t)probe_get_be(payload + 2, 2);
+    pr->seq = (uint32_t)probe_get_be(payload + 4, 4);
+    pr->send_ns = probe_get_be(payload + 8, 8);
+    return 0;
+}
+
+#endif /* PROBE_H */